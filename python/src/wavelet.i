@@ -97,6 +97,7 @@ namespace wavelet {
     WRAP_ATTR_TEMPLATES(Family, Family)
     WRAP_ATTR_TEMPLATES(WaveletDomain, Wavelet::WaveletDomain)
     WRAP_ATTR_TEMPLATES(Optimisation, Filterbank::Optimisation)
+    WRAP_ATTR_TEMPLATES(DecimationPolicy, Filterbank::DecimationPolicy)
 };
 
 // Rewrite interface to set Attributes
@@ -117,7 +118,28 @@ def setAttribute(self, attr_name, attr_value):
     Value range: > 1.
 'optimisation' [Optimisation]:
     Optimisation mode the filterbank implementation
-    Value range: {NONE, STANDARD, AGRESSIVE}
+    Value range: {NONE, STANDARD, AGRESSIVE, HETERODYNE, ATROUS}
+'threads' [unsigned int]:
+    Number of threads used to compute the wavelet kernels
+    Value range: >= 1
+'accuracy' [float]:
+    Maximum relative error of the kernel truncation (dB), 0 disables truncation
+    Value range: <= 0.
+'lowrank_accuracy' [float]:
+    Maximum relative error of the low-rank stage kernels (dB), 0 disables the approximation
+    Value range: <= 0.
+'decimation' [DecimationPolicy]:
+    Quantization policy of the downsampling factors
+    Value range: {EXACT, POW2, CUSTOM}
+'predecimation' [bool]:
+    Decimate the input once for the whole filterbank (driven by frequency_max)
+    Value range: {True, False}
+'cpu_budget' [float]:
+    Processing time budget of the online estimation (microseconds per sample), 0 disables the degradation
+    Value range: >= 0.
+'max_latency' [unsigned int]:
+    Maximum latency of the FFT-partitioned bands (samples), 0 disables the FFT convolution
+    Value range: >= 0
 'family' [Family]:
     Wavelet Family
     Value range: {MORLET, PAUL}
@@ -222,6 +244,11 @@ Paul Wavelet:
         return
     except:
         pass
+    try:
+        self._setAttribute_DecimationPolicy(attr_name, attr_value)
+        return
+    except:
+        pass
     raise Exception("Ooops, it seems that the wrapper for this attribute is not implemented...")
 
 Filterbank.setAttribute = setAttribute
@@ -246,7 +273,28 @@ def getAttribute(self, attr_name):
     Value range: > 1.
 'optimisation' [Optimisation]:
     Optimisation mode the filterbank implementation
-    Value range: {NONE, STANDARD, AGRESSIVE}
+    Value range: {NONE, STANDARD, AGRESSIVE, HETERODYNE, ATROUS}
+'threads' [unsigned int]:
+    Number of threads used to compute the wavelet kernels
+    Value range: >= 1
+'accuracy' [float]:
+    Maximum relative error of the kernel truncation (dB), 0 disables truncation
+    Value range: <= 0.
+'lowrank_accuracy' [float]:
+    Maximum relative error of the low-rank stage kernels (dB), 0 disables the approximation
+    Value range: <= 0.
+'decimation' [DecimationPolicy]:
+    Quantization policy of the downsampling factors
+    Value range: {EXACT, POW2, CUSTOM}
+'predecimation' [bool]:
+    Decimate the input once for the whole filterbank (driven by frequency_max)
+    Value range: {True, False}
+'cpu_budget' [float]:
+    Processing time budget of the online estimation (microseconds per sample), 0 disables the degradation
+    Value range: >= 0.
+'max_latency' [unsigned int]:
+    Maximum latency of the FFT-partitioned bands (samples), 0 disables the FFT convolution
+    Value range: >= 0
 'family' [Family]:
     Wavelet Family
     Value range: {MORLET, PAUL}
@@ -336,6 +384,10 @@ Paul Wavelet:
         return self._getAttribute_Optimisation(attr_name)
     except:
         pass
+    try:
+        return self._getAttribute_DecimationPolicy(attr_name)
+    except:
+        pass
     raise Exception("Ooops, it seems that the wrapper for this attribute is not implemented...")
 
 Filterbank.getAttribute = getAttribute
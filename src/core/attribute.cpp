@@ -33,10 +33,50 @@
 #include "attribute.hpp"
 #include <string>
 
+static const char* attribute_names[wavelet::ATTR_UNKNOWN] = {
+    "samplerate",
+    "scale",
+    "window_size",
+    "mode",
+    "delay",
+    "padding",
+    "omega0",
+    "order",
+    "frequency_min",
+    "frequency_max",
+    "bands_per_octave",
+    "optimisation",
+    "family",
+    "rescale",
+    "threads",
+    "accuracy",
+    "lowrank_accuracy",
+    "decimation",
+    "predecimation",
+    "cpu_budget",
+    "max_latency"
+};
+
+wavelet::AttributeId wavelet::attributeId(std::string const& attr_name)
+{
+    for (unsigned char i=0; i<ATTR_UNKNOWN; ++i) {
+        if (attr_name == attribute_names[i])
+            return static_cast<AttributeId>(i);
+    }
+    return ATTR_UNKNOWN;
+}
+
+std::string wavelet::attributeName(AttributeId attr_id)
+{
+    if (attr_id >= ATTR_UNKNOWN)
+        return "";
+    return attribute_names[attr_id];
+}
+
 template <>
-void wavelet::checkLimits<bool>(bool const& value,
-                                bool const& limit_min,
-                                bool const& limit_max)
+void wavelet::checkLimits<bool>(bool const&,
+                                bool const&,
+                                bool const&)
 {
 }
 
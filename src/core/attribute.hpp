@@ -37,10 +37,62 @@
 #include <stdexcept>
 #include <limits>
 #include <vector>
-#include <boost/any.hpp>
+#include <string>
 
 namespace wavelet {
     
+#pragma mark -
+#pragma mark === Attribute Identifiers ===
+    /**
+     * @brief Identifiers of the attributes of the library
+     * @details Integer identifiers allow accessing attributes without string comparisons
+     * (see AttributeHandler::setAttribute and AttributeHandler::getAttribute)
+     */
+    enum AttributeId : unsigned char {
+        ATTR_SAMPLERATE = 0,
+        ATTR_SCALE,
+        ATTR_WINDOW_SIZE,
+        ATTR_MODE,
+        ATTR_DELAY,
+        ATTR_PADDING,
+        ATTR_OMEGA0,
+        ATTR_ORDER,
+        ATTR_FREQUENCY_MIN,
+        ATTR_FREQUENCY_MAX,
+        ATTR_BANDS_PER_OCTAVE,
+        ATTR_OPTIMISATION,
+        ATTR_FAMILY,
+        ATTR_RESCALE,
+        ATTR_THREADS,
+        ATTR_ACCURACY,
+        ATTR_LOWRANK_ACCURACY,
+        ATTR_DECIMATION,
+        ATTR_PREDECIMATION,
+        ATTR_CPU_BUDGET,
+        ATTR_MAX_LATENCY,
+        
+        /**
+         * @brief Unknown attribute (also used as the number of identifiers)
+         */
+        ATTR_UNKNOWN
+    };
+    
+    /**
+     * @brief get the identifier of an attribute from its name
+     * @param attr_name attribute name
+     * @return attribute identifier (ATTR_UNKNOWN if the name does not match any attribute)
+     */
+    AttributeId attributeId(std::string const& attr_name);
+    
+    /**
+     * @brief get the name of an attribute from its identifier
+     * @param attr_id attribute identifier
+     * @return attribute name (empty string if the identifier is unknown)
+     */
+    std::string attributeName(AttributeId attr_id);
+    
+    template <typename T> class Attribute;
+    
 #pragma mark -
 #pragma mark === Functions checkLimits ===
     ///@cond DEVDOC
@@ -52,9 +104,9 @@ namespace wavelet {
      * @param limit_max maximum value
      */
     template <typename T>
-    void checkLimits(T const& value,
-                     T const& limit_min,
-                     T const& limit_max)
+    void checkLimits(T const&,
+                     T const&,
+                     T const&)
     {
         throw std::runtime_error("Attribute limits are not implemented for the current type.");
     }
@@ -117,6 +169,12 @@ namespace wavelet {
         AttributeBase() : changed(false)
         {}
         
+        /**
+         * @brief Destructor
+         */
+        virtual ~AttributeBase()
+        {}
+        
         /**
          * @brief Defines if the value has been changed
          */
@@ -127,6 +185,9 @@ namespace wavelet {
 #pragma mark === Class AttributeHandler ===
     /**
      * @brief Attribute notification handler
+     * @details Also provides generic access to the attributes by identifier or by name.
+     * Attributes delegated to another handler (e.g. the wavelet attributes of a Filterbank)
+     * notify both their parent and the handler through which they were set.
      */
     class AttributeHandler {
         template <typename T> friend class Attribute;
@@ -137,11 +198,108 @@ namespace wavelet {
          */
         virtual ~AttributeHandler() {}
         
+        /**
+         * @brief set attribute value by identifier
+         * @param attr_id attribute identifier
+         * @param attr_value attribute value
+         * @return false if the attribute does not exist, if the type does not match
+         * the attribute's internal type, or if the value exceeds the limits
+         * @details invalid requests are rejected without allocating nor throwing exceptions.
+         * A valid change notifies the handler (see onAttributeChange), which may reinitialize
+         * its internal structures: this allocates, and throws if the new configuration cannot
+         * be built. Floating-point values are accepted (truncated) for unsigned integer attributes.
+         */
+        template <typename T>
+        bool setAttribute(AttributeId attr_id, T const& attr_value);
+        
+        /**
+         * @brief get attribute value by identifier
+         * @param attr_id attribute identifier
+         * @param attr_value attribute value (unchanged if the request fails)
+         * @return false if the attribute does not exist or if the type does not match
+         * the attribute's internal type
+         * @details does not allocate nor throw exceptions
+         */
+        template <typename T>
+        bool getAttribute(AttributeId attr_id, T& attr_value) const noexcept;
+        
+        /**
+         * @brief set attribute value by name
+         * @param attr_name attribute name
+         * @param attr_value attribute value
+         * @throws runtime_error if the attribute does not exist or if the type does not match the attribute's internal type
+         * @throws domain_error if the value exceeds the limits
+         * @details Floating-point values are accepted (truncated) for unsigned integer attributes.
+         */
+        template <typename T>
+        void setAttribute(std::string attr_name, T attr_value);
+        
+        /**
+         * @brief get attribute value by name
+         * @param attr_name attribute name
+         * @return attribute value
+         * @throws runtime_error if the attribute does not exist or if the type does not match the attribute's internal type
+         */
+        template <typename T>
+        T getAttribute(std::string attr_name) const;
+        
     protected:
         /**
          * @brief notification function called when a member attribute is changed
          */
         virtual void onAttributeChange(AttributeBase* attr_pointer) = 0;
+        
+        /**
+         * @brief get a pointer to an attribute by identifier
+         * @param attr_id attribute identifier
+         * @return pointer to the attribute, or nullptr if the attribute does not exist or is not accessible
+         */
+        virtual AttributeBase* attribute(AttributeId)
+        {
+            return nullptr;
+        }
+        
+        /**
+         * @brief get a pointer to an attribute by identifier
+         * @param attr_id attribute identifier
+         * @return pointer to the attribute, or nullptr if the attribute does not exist or is not accessible
+         */
+        AttributeBase const* attribute(AttributeId attr_id) const
+        {
+            return const_cast<AttributeHandler*>(this)->attribute(attr_id);
+        }
+        
+    private:
+        /**
+         * @brief conversion of floating-point values for unsigned integer attributes
+         * @details keeps setting integer attributes (e.g. the order of the Paul wavelet)
+         * from floating-point values, as the accessors did before they were typed.
+         * Negative values map to 0, so that they are rejected by the limits.
+         * @param attr_value requested attribute value
+         * @param int_value converted value
+         * @return true if the value type can be converted
+         */
+        template <typename T>
+        static bool integerValue(T const&, unsigned int&)
+        {
+            return false;
+        }
+        
+        static bool integerValue(float const& attr_value, unsigned int& int_value)
+        {
+            return integerValue(double(attr_value), int_value);
+        }
+        
+        static bool integerValue(double const& attr_value, unsigned int& int_value)
+        {
+            if (!(attr_value > 0.))
+                int_value = 0;
+            else if (attr_value >= double(std::numeric_limits<unsigned int>::max()))
+                int_value = std::numeric_limits<unsigned int>::max();
+            else
+                int_value = static_cast<unsigned int>(attr_value);
+            return true;
+        }
     };
     ///@endcond
     
@@ -228,6 +386,20 @@ namespace wavelet {
                 parent_->onAttributeChange(this);
         }
         
+        /**
+         * @brief Set the attribute value if it lies within the limits
+         * @param value requested value
+         * @param silently if true, don't notify the parent object
+         * @return false if the value exceeds the limits (the attribute is left unchanged)
+         */
+        bool try_set(T const& value, bool silently = false)
+        {
+            if (value < limit_min_ || value > limit_max_)
+                return false;
+            set(value, silently);
+            return true;
+        }
+        
         /**
          * @brief get the attribute's current value
          * @return the attribute's current value
@@ -276,6 +448,24 @@ namespace wavelet {
             set_limit_max(limit_max);
         }
         
+        /**
+         * @brief get the attribute's minimum value
+         * @return minimum value
+         */
+        T get_limit_min() const
+        {
+            return limit_min_;
+        }
+        
+        /**
+         * @brief get the attribute's maximum value
+         * @return maximum value
+         */
+        T get_limit_max() const
+        {
+            return limit_max_;
+        }
+        
         /**
          * @brief set the parent to receive change notifications
          * @param parent parent object
@@ -329,6 +519,64 @@ namespace wavelet {
         
         ///@endcond
     };
+    
+#pragma mark -
+#pragma mark === AttributeHandler: generic accessors ===
+    template <typename T>
+    bool AttributeHandler::setAttribute(AttributeId attr_id, T const& attr_value)
+    {
+        AttributeBase* attr_base = attribute(attr_id);
+        Attribute<T>* attr = dynamic_cast<Attribute<T>*>(attr_base);
+        unsigned int int_value;
+        if (!attr && dynamic_cast<Attribute<unsigned int>*>(attr_base) && integerValue(attr_value, int_value))
+            return setAttribute(attr_id, int_value);
+        if (!attr || !attr->try_set(attr_value))
+            return false;
+        if (attr->get_parent() != this)
+            onAttributeChange(attr);
+        return true;
+    }
+    
+    template <typename T>
+    bool AttributeHandler::getAttribute(AttributeId attr_id, T& attr_value) const noexcept
+    {
+        Attribute<T> const* attr = dynamic_cast<Attribute<T> const*>(attribute(attr_id));
+        if (!attr)
+            return false;
+        attr_value = attr->get();
+        return true;
+    }
+    
+    template <typename T>
+    void AttributeHandler::setAttribute(std::string attr_name, T attr_value)
+    {
+        AttributeBase* attr_base = attribute(attributeId(attr_name));
+        if (!attr_base)
+            throw std::runtime_error("Attribute " + attr_name + " does not exist or is not accessible.");
+        Attribute<T>* attr = dynamic_cast<Attribute<T>*>(attr_base);
+        unsigned int int_value;
+        if (!attr && dynamic_cast<Attribute<unsigned int>*>(attr_base) && integerValue(attr_value, int_value)) {
+            setAttribute(attr_name, int_value);
+            return;
+        }
+        if (!attr)
+            throw std::runtime_error("Argument value type does not match Attribute type");
+        attr->set(attr_value);
+        if (attr->get_parent() != this)
+            onAttributeChange(attr);
+    }
+    
+    template <typename T>
+    T AttributeHandler::getAttribute(std::string attr_name) const
+    {
+        AttributeBase const* attr_base = attribute(attributeId(attr_name));
+        if (!attr_base)
+            throw std::runtime_error("Attribute " + attr_name + " does not exist or is not accessible.");
+        Attribute<T> const* attr = dynamic_cast<Attribute<T> const*>(attr_base);
+        if (!attr)
+            throw std::runtime_error("Return value type does not match Attribute type");
+        return attr->get();
+    }
 }
 
 #endif
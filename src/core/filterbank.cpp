@@ -31,7 +31,309 @@
  */
 
 #include "filterbank.hpp"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <exception>
 #include <memory>
+#include <thread>
+
+namespace {
+    /**
+     * @brief Identifier of the filterbank snapshot files
+     */
+    const char snapshot_magic[4] = {'W', 'V', 'L', 'T'};
+    
+    /**
+     * @brief Version of the snapshot format
+     */
+    const std::uint32_t snapshot_version = 1;
+    
+    /**
+     * @brief Byte order mark (snapshots are written in the native byte order)
+     */
+    const std::uint32_t snapshot_byte_order = 0x01020304;
+    
+    /**
+     * @brief Number of frames per tile of the block update
+     * @details The accumulators of a tile (real and imaginary parts) fit in registers, and each
+     * kernel coefficient loaded from the arena is reused for the whole tile. The decimated
+     * samples of a stage are read through a sliding window, which stays in the L1 cache.
+     */
+    const std::size_t block_frames = 16;
+    
+    /**
+     * @brief Defines if two wavelets have the same discrete kernel
+     * @details the kernel only depends on the window size and on the width of the wavelet in samples
+     * (scale * samplerate): a band at scale s decimated by d has the same kernel as the band at scale 2s
+     * decimated by 2d. The widths are compared with a relative tolerance to absorb the rounding of the scales.
+     */
+    bool same_kernel(wavelet::Wavelet const& a, wavelet::Wavelet const& b)
+    {
+        double width_a = a.scale.get() * a.samplerate.get();
+        double width_b = b.scale.get() * b.samplerate.get();
+        return (a.window_size.get() == b.window_size.get() &&
+                a.mode.get() == b.mode.get() &&
+                std::abs(width_a - width_b) <= 1e-9 * width_a);
+    }
+    
+    /**
+     * @brief Defines if an optimisation mode decimates the bands in shared stages
+     * @details the HETERODYNE mode keeps the bands at the input rate, and decimates their baseband
+     */
+    bool decimated_stages(wavelet::Filterbank::Optimisation mode)
+    {
+        return (mode == wavelet::Filterbank::STANDARD || mode == wavelet::Filterbank::AGRESSIVE || mode == wavelet::Filterbank::ATROUS);
+    }
+    
+    /**
+     * @brief B3-spline kernel of the a trous cascade: (1, 4, 6, 4, 1) / 16 (center and right half)
+     */
+    const float atrous_kernel[3] = {6.f / 16.f, 4.f / 16.f, 1.f / 16.f};
+    
+    /**
+     * @brief Amplitude response of the a trous cascade up to a level
+     * @details the B3-spline kernel dilated by a hole h has the response cos^4(h omega / 2)
+     * @param factor downsampling factor of the level (power of two)
+     * @param omega angular frequency (rad/sample)
+     */
+    double atrous_response(int factor, double omega)
+    {
+        double response(1.);
+        for (int hole=1; hole<factor; hole*=2)
+            response *= std::pow(std::cos(double(hole) * omega / 2.), 4);
+        return response;
+    }
+    
+    /**
+     * @brief Kernel truncation accuracy (dB) of each degradation level (0: not truncated)
+     */
+    const float degradation_accuracies[4] = {0., 0., -40., -20.};
+    
+#ifdef USE_ARMA
+    /**
+     * @brief Throughput of the BLAS matrix-vector product relative to the dot products of the kernels (cost model of DENSE stages)
+     */
+    const double dense_speedup = 4.;
+#endif
+    
+    /**
+     * @brief Index of the kernel plan of a degradation level (levels with the same truncation share the plan of the first one)
+     * @param level degradation level
+     */
+    std::size_t degradation_plan(std::size_t level)
+    {
+        std::size_t plan(0);
+        while (degradation_accuracies[plan] != degradation_accuracies[level])
+            plan++;
+        return plan;
+    }
+    
+    /**
+     * @brief Time constant of the average processing time (samples)
+     */
+    const double cpu_window = 256.;
+    
+    /**
+     * @brief Minimum number of samples measured at a degradation level before it can change
+     */
+    const std::size_t cpu_settling = 1024;
+    
+    /**
+     * @brief Fraction of the budget below which the previous degradation level is restored
+     */
+    const double cpu_recovery = 0.8;
+    
+    /**
+     * @brief Decimation factor of the front-end stage
+     * @details largest factor that keeps frequency_max below a quarter of the decimated sampling rate
+     * (the same criterion as the downsampling factors of the bands)
+     * @param enabled defines if the input is pre-decimated
+     * @param samplerate sampling rate of the input
+     * @param frequency_max maximum frequency of the filterbank
+     */
+    int frontend_decimation(bool enabled, double samplerate, double frequency_max)
+    {
+        if (!enabled)
+            return 1;
+        double samplerate_ratio = (samplerate / 4.) / frequency_max;
+        return (samplerate_ratio > 1.) ? static_cast<int>(samplerate_ratio) : 1;
+    }
+    
+    /**
+     * @brief Eigendecomposition of a real symmetric matrix (cyclic Jacobi method)
+     * @param matrix row-major n x n symmetric matrix, replaced by a diagonal matrix of eigenvalues
+     * @param n size of the matrix
+     * @param eigenvectors row-major n x n matrix of eigenvectors (one per column)
+     */
+    void symmetric_eigen(std::vector<double>& matrix, std::size_t n, std::vector<double>& eigenvectors)
+    {
+        eigenvectors.assign(n * n, 0.);
+        double norm(0.);
+        for (std::size_t p=0; p<n; p++) {
+            eigenvectors[p * n + p] = 1.;
+            for (std::size_t q=0; q<n; q++)
+                norm += matrix[p * n + q] * matrix[p * n + q];
+        }
+        for (unsigned int sweep=0; sweep<100; sweep++) {
+            double off_diagonal(0.);
+            for (std::size_t p=0; p<n; p++) {
+                for (std::size_t q=p+1; q<n; q++)
+                    off_diagonal += matrix[p * n + q] * matrix[p * n + q];
+            }
+            if (off_diagonal <= 1e-30 * norm)
+                return;
+            for (std::size_t p=0; p<n; p++) {
+                for (std::size_t q=p+1; q<n; q++) {
+                    double a_pq = matrix[p * n + q];
+                    if (a_pq == 0.)
+                        continue;
+                    // Rotation canceling a_pq: t = tan(phi), with cot(2 phi) = (a_qq - a_pp) / (2 a_pq)
+                    double theta = (matrix[q * n + q] - matrix[p * n + p]) / (2. * a_pq);
+                    double t = ((theta >= 0.) ? 1. : -1.) / (std::abs(theta) + std::sqrt(theta * theta + 1.));
+                    double c = 1. / std::sqrt(t * t + 1.);
+                    double s = t * c;
+                    for (std::size_t k=0; k<n; k++) {
+                        double a_kp = matrix[k * n + p];
+                        double a_kq = matrix[k * n + q];
+                        matrix[k * n + p] = c * a_kp - s * a_kq;
+                        matrix[k * n + q] = s * a_kp + c * a_kq;
+                    }
+                    for (std::size_t k=0; k<n; k++) {
+                        double a_pk = matrix[p * n + k];
+                        double a_qk = matrix[q * n + k];
+                        matrix[p * n + k] = c * a_pk - s * a_qk;
+                        matrix[q * n + k] = s * a_pk + c * a_qk;
+                    }
+                    for (std::size_t k=0; k<n; k++) {
+                        double v_kp = eigenvectors[k * n + p];
+                        double v_kq = eigenvectors[k * n + q];
+                        eigenvectors[k * n + p] = c * v_kp - s * v_kq;
+                        eigenvectors[k * n + q] = s * v_kp + c * v_kq;
+                    }
+                }
+            }
+        }
+    }
+    
+    /**
+     * @brief In-place radix-2 FFT (iterative Cooley-Tukey)
+     * @param data complex sequence (its size is a power of two), replaced by its DFT
+     * @param twiddles twiddle factors exp(-2 i pi k / n), k < n / 2
+     */
+    void fft_radix2(std::vector< std::complex<double> >& data, std::vector< std::complex<double> > const& twiddles)
+    {
+        std::size_t n = data.size();
+        for (std::size_t i=1, j=0; i<n; i++) {
+            std::size_t bit = n >> 1;
+            for (; j & bit; bit >>= 1)
+                j ^= bit;
+            j ^= bit;
+            if (i < j)
+                std::swap(data[i], data[j]);
+        }
+        for (std::size_t length=2; length<=n; length<<=1) {
+            std::size_t half = length / 2;
+            std::size_t stride = n / length;
+            for (std::size_t start=0; start<n; start+=length) {
+                for (std::size_t k=0; k<half; k++) {
+                    std::complex<double> odd = data[start + half + k] * twiddles[k * stride];
+                    data[start + half + k] = data[start + k] - odd;
+                    data[start + k] += odd;
+                }
+            }
+        }
+    }
+    
+    /**
+     * @brief Twiddle factors of the radix-2 FFT
+     * @param n size of the FFT
+     * @return exp(-2 i pi k / n), k < n / 2
+     */
+    std::vector< std::complex<double> > fft_twiddles(std::size_t n)
+    {
+        std::vector< std::complex<double> > twiddles(n / 2);
+        for (std::size_t k=0; k<n/2; k++)
+            twiddles[k] = std::polar(1., -2. * M_PI * double(k) / double(n));
+        return twiddles;
+    }
+    
+    /**
+     * @brief Identifier of the serialized streaming states
+     */
+    const char state_magic[4] = {'W', 'V', 'L', 'S'};
+    
+    /**
+     * @brief Version of the streaming state format
+     */
+    const std::uint32_t state_version = 1;
+    
+    template <typename T>
+    void write_binary(std::ostream& stream, T const& value)
+    {
+        stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    
+    template <typename T>
+    void write_binary(std::vector<char>& buffer, T const& value)
+    {
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+    
+    /**
+     * @brief FNV-1a hash accumulator
+     */
+    template <typename T>
+    void hash_combine(std::uint64_t& hash, T const& value)
+    {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+        for (std::size_t i=0; i<sizeof(T); i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+    
+    /**
+     * @brief Bounds-checked reader over a memory-mapped snapshot
+     */
+    class SnapshotReader {
+    public:
+        SnapshotReader(const char* data, std::size_t size) :
+        position_(data),
+        end_(data + size)
+        {}
+        
+        void read(void* dst, std::size_t size)
+        {
+            if (size > static_cast<std::size_t>(end_ - position_))
+                throw std::runtime_error("Filterbank snapshot is corrupted (unexpected end of file)");
+            std::memcpy(dst, position_, size);
+            position_ += size;
+        }
+        
+        template <typename T>
+        T read()
+        {
+            T value;
+            read(&value, sizeof(T));
+            return value;
+        }
+        
+        std::size_t remaining() const
+        {
+            return static_cast<std::size_t>(end_ - position_);
+        }
+        
+    private:
+        const char* position_;
+        const char* end_;
+    };
+}
 
 wavelet::Filterbank::Filterbank(float samplerate_,
                                 float frequency_min_,
@@ -42,7 +344,30 @@ frequency_max(this, frequency_max_, frequency_min_, samplerate_/2.),
 bands_per_octave(this, bands_per_octave_, 1.),
 optimisation(this, NONE),
 family(this, DEFAULT_FAMILY),
-rescale(this, true)
+rescale(this, true),
+threads(this, 1, 1),
+accuracy(this, 0., std::numeric_limits<float>::lowest(), 0.),
+lowrank_accuracy(this, 0., std::numeric_limits<float>::lowest(), 0.),
+decimation(this, EXACT),
+predecimation(this, false),
+cpu_budget(this, 0., 0.),
+max_latency(this, 0, 0),
+frontend_factor_(1),
+frontend_index_(0),
+spectral_hop_(0),
+spectral_accuracy_(0.),
+spectral_count_(0),
+spectral_fingerprint_(0),
+spectral_prepad_index_(0),
+degradation_(NOMINAL),
+cpu_load_(0.),
+cpu_samples_(0),
+cpu_timing_(false),
+degradation_entry_load_(0.),
+degradation_speedups_(SHORTER_KERNELS + 1, 0.),
+config_transaction_(false),
+config_changed_(false),
+config_full_init_(false)
 {
     switch (family.get()) {
         case wavelet::MORLET:
@@ -61,7 +386,23 @@ rescale(this, true)
     init();
 }
 
-wavelet::Filterbank::Filterbank(Filterbank const& src)
+wavelet::Filterbank::Filterbank(Filterbank const& src) :
+frontend_factor_(1),
+frontend_index_(0),
+spectral_hop_(0),
+spectral_accuracy_(0.),
+spectral_count_(0),
+spectral_fingerprint_(0),
+spectral_prepad_index_(0),
+degradation_(NOMINAL),
+cpu_load_(0.),
+cpu_samples_(0),
+cpu_timing_(false),
+degradation_entry_load_(0.),
+degradation_speedups_(SHORTER_KERNELS + 1, 0.),
+config_transaction_(false),
+config_changed_(false),
+config_full_init_(false)
 {
     this->frequency_min = src.frequency_min;
     this->frequency_min.set_parent(this);
@@ -75,6 +416,21 @@ wavelet::Filterbank::Filterbank(Filterbank const& src)
     this->family.set_parent(this);
     this->rescale = src.rescale;
     this->rescale.set_parent(this);
+    this->threads = src.threads;
+    this->threads.set_parent(this);
+    this->accuracy = src.accuracy;
+    this->accuracy.set_parent(this);
+    this->lowrank_accuracy = src.lowrank_accuracy;
+    this->lowrank_accuracy.set_parent(this);
+    this->decimation = src.decimation;
+    this->decimation.set_parent(this);
+    this->decimation_rates_ = src.decimation_rates_;
+    this->predecimation = src.predecimation;
+    this->predecimation.set_parent(this);
+    this->cpu_budget = src.cpu_budget;
+    this->cpu_budget.set_parent(this);
+    this->max_latency = src.max_latency;
+    this->max_latency.set_parent(this);
     switch (this->family.get()) {
         case wavelet::MORLET:
             this->reference_wavelet_ = std::unique_ptr<MorletWavelet>(new MorletWavelet(*std::static_pointer_cast<MorletWavelet>(src.reference_wavelet_)));
@@ -89,6 +445,8 @@ wavelet::Filterbank::Filterbank(Filterbank const& src)
             break;
     }
     this->init();
+    if (src.spectral_hop_ > 0)
+        this->initSpectral(src.spectral_hop_, src.spectral_accuracy_);
 }
 
 wavelet::Filterbank& wavelet::Filterbank::operator=(Filterbank const& src)
@@ -106,9 +464,34 @@ wavelet::Filterbank& wavelet::Filterbank::operator=(Filterbank const& src)
         this->family.set_parent(this);
         this->rescale = src.rescale;
         this->rescale.set_parent(this);
+        this->threads = src.threads;
+        this->threads.set_parent(this);
+        this->accuracy = src.accuracy;
+        this->accuracy.set_parent(this);
+        this->lowrank_accuracy = src.lowrank_accuracy;
+        this->lowrank_accuracy.set_parent(this);
+        this->decimation = src.decimation;
+        this->decimation.set_parent(this);
+        this->decimation_rates_ = src.decimation_rates_;
+        this->predecimation = src.predecimation;
+        this->predecimation.set_parent(this);
+        this->cpu_budget = src.cpu_budget;
+        this->cpu_budget.set_parent(this);
+        this->max_latency = src.max_latency;
+        this->max_latency.set_parent(this);
+        this->degradation_ = NOMINAL;
+        this->cpu_load_ = 0.;
+        this->cpu_samples_ = 0;
+        this->degradation_speedups_.assign(SHORTER_KERNELS + 1, 0.);
+        this->config_transaction_ = false;
+        this->config_changed_ = false;
+        this->config_full_init_ = false;
         this->reference_wavelet_ = std::unique_ptr<MorletWavelet>(new MorletWavelet(src.reference_wavelet_->samplerate.get()));
         *(this->reference_wavelet_) = *(src.reference_wavelet_);
         this->init();
+        this->spectral_hop_ = 0;
+        if (src.spectral_hop_ > 0)
+            this->initSpectral(src.spectral_hop_, src.spectral_accuracy_);
         
     }
     return *this;
@@ -125,31 +508,798 @@ std::string wavelet::Filterbank::info() const
     infostrstream << "\tFrequency Range: " << frequency_min.get() << " " << frequency_max.get() << "\n";
     infostrstream << "\tBands per Octave: " << bands_per_octave.get() << "\n";
     infostrstream << "\tOptimisation: " << optimisation.get() << "\n";
+    if (frontend_factor_ > 1) {
+        infostrstream << "\tPre-decimation: " << frontend_factor_ << "\n";
+    }
+    if (decimated_stages(optimisation.get())) {
+        std::vector<double> margins = aliasingMargins();
+        double min_margin = margins.empty() ? 0. : *std::min_element(margins.begin(), margins.end());
+        const char* policy_names[] = {"EXACT", "POW2", "CUSTOM"};
+        // Bands sharing a kernel point back to an earlier offset of the arena
+        std::size_t num_kernels(0);
+        std::size_t arena_end(0);
+        for (auto const& band : bands_) {
+            if (num_kernels == 0 || band.offset >= arena_end) {
+                num_kernels++;
+                arena_end = band.offset + 2 * band.half_size;
+            }
+        }
+        infostrstream << "\tDecimation: " << policy_names[decimation.get()] << " (stages: " << stages_.size()
+        << ", distinct kernels: " << num_kernels << "/" << bands_.size()
+        << ", memory (bytes): " << stageMemory()
+        << ", multiplies per sample: " << multipliesPerSample()
+        << ", minimum anti-aliasing margin: " << min_margin << ")\n";
+        if (optimisation.get() == ATROUS)
+            infostrstream << "\tA trous cascade: " << data_.size() << " levels (B3-spline kernel, 3 multiplies per level)\n";
+    }
+    if (accuracy.get() < 0.) {
+        std::size_t macs_full(0);
+        std::size_t macs_saved(0);
+        for (std::size_t i=0; i<size(); i++) {
+            macs_full += wavelets_[i]->window_size.get();
+            macs_saved += wavelets_[i]->window_size.get() - bands_[i].window_size;
+        }
+        infostrstream << "\tAccuracy (dB): " << accuracy.get() << " (MACs saved per update: " << macs_saved << " / " << macs_full << ")\n";
+    }
+    if (lowrank_accuracy.get() < 0.) {
+        infostrstream << "\tLow-rank Accuracy (dB): " << lowrank_accuracy.get() << " (rank / kernel rows per stage:";
+        for (auto const& stage : stages_)
+            infostrstream << " " << stage.rank << "/" << 2 * stage.num_bands;
+        infostrstream << ")\n";
+    }
+    if (!stages_.empty()) {
+        const char* algorithm_names[] = {"direct", "symmetric", "low-rank", "dense", "heterodyne", "fft-partitioned"};
+        infostrstream << "\tPlan (multiplies per update";
+        if (max_latency.get() > 0)
+            infostrstream << ", maximum latency: " << max_latency.get() << " samples";
+        infostrstream << "):\n";
+        for (auto const& stage : stages_) {
+            std::size_t counts[6] = {0, 0, 0, 0, 0, 0};
+            double cost(0.);
+            for (std::size_t i=stage.first_band; i<stage.first_band+stage.num_bands; i++) {
+                counts[bands_[i].algorithm]++;
+                cost += bands_[i].cost;
+            }
+            infostrstream << "\t\tDecimation " << stage.decimation << " (bands " << stage.first_band << "-" << stage.first_band + stage.num_bands - 1 << "):";
+            for (std::size_t algorithm=0; algorithm<6; algorithm++) {
+                if (counts[algorithm] > 0)
+                    infostrstream << " " << algorithm_names[algorithm] << " x" << counts[algorithm];
+            }
+            if (counts[BandDescriptor::PARTITIONED] > 0)
+                infostrstream << " [block size " << stage.block_size << "]";
+            infostrstream << " (" << cost << ")\n";
+        }
+    }
+    if (cpu_budget.get() > 0.) {
+        const char* degradation_names[] = {"nominal", "skip frames", "short kernels", "shorter kernels"};
+        infostrstream << "\tCPU budget (us per sample): " << cpu_budget.get() << " (load: " << cpu_load_
+        << ", degradation: " << degradation_names[degradation_] << ")\n";
+    }
+    if (spectral_hop_ > 0) {
+        infostrstream << "\tConstant-Q engine: FFT size " << spectral_spectrum_.size() << ", hop " << spectral_hop_
+        << " (nonzero kernel bins: " << spectral_bins_.size() << ", multiplies per frame: " << spectralMultiplies() << ")\n";
+    }
     if (!wavelets_.empty()) {
         infostrstream << reference_wavelet_->info();
     }
     return infostrstream.str();
 }
 
+wavelet::Filterbank::Degradation wavelet::Filterbank::degradation() const
+{
+    return degradation_;
+}
+
+double wavelet::Filterbank::cpuLoad() const
+{
+    return cpu_load_;
+}
+
+void wavelet::Filterbank::setKernelCache(std::shared_ptr<KernelCache> kernel_cache)
+{
+    reference_wavelet_->setKernelCache(kernel_cache);
+    for (auto &wavelet : wavelets_) {
+        wavelet->setKernelCache(kernel_cache);
+    }
+}
+
+std::shared_ptr<wavelet::KernelCache> wavelet::Filterbank::getKernelCache() const
+{
+    return reference_wavelet_->getKernelCache();
+}
+
 std::vector<int> wavelet::Filterbank::delaysInSamples() const
 {
+    // Group delay of a low-pass filter at DC
+    auto group_delay = [](LowpassFilter const& filter) {
+        double sum_b(0.), moment_b(0.), sum_a(0.), moment_a(0.);
+        for (std::size_t k=0; k<filter.b.size(); k++) {
+            sum_b += filter.b[k];
+            moment_b += k * filter.b[k];
+            sum_a += filter.a[k];
+            moment_a += k * filter.a[k];
+        }
+        return moment_b / sum_b - moment_a / sum_a;
+    };
+    
+    // Front-end decimation: group delay of the low-pass filter
+    double frontend_latency = (frontend_factor_ > 1) ? group_delay(frontend_filter_) : 0.;
     std::vector<int> delays(size());
     unsigned int i(0);
     for (auto &wav : wavelets_) {
-        delays[i++] = wav->delay.get() * wav->eFoldingTime() * reference_wavelet_->samplerate.get();
+        delays[i] = wav->delay.get() * wav->eFoldingTime() * reference_wavelet_->samplerate.get() + std::round(frontend_latency);
+        // Heterodyne channel: group delay of the baseband filter (at the rate of the stages)
+        if (i < heterodyne_.size() && heterodyne_[i].decimation > 0)
+            delays[i] += static_cast<int>(std::round(group_delay(heterodyne_[i].filter_real) * double(frontend_factor_)));
+        // A trous cascade: each (centered) B3-spline kernel delays its level by twice its hole
+        if (optimisation.get() == ATROUS)
+            delays[i] += 2 * (downsampling_factors[i] - 1) * frontend_factor_;
+        i++;
+    }
+    // FFT-partitioned bands: the outputs of a block are emitted during the next block
+    for (auto const& stage : stages_) {
+        for (std::size_t band_index=stage.first_band; band_index<stage.first_band+stage.num_bands; band_index++) {
+            if (bands_[band_index].algorithm == BandDescriptor::PARTITIONED)
+                delays[band_index] += static_cast<int>(stage.block_size - 1) * frontend_factor_;
+        }
     }
     return delays;
 }
 
+std::vector<std::size_t> wavelet::Filterbank::macSavings() const
+{
+    std::vector<std::size_t> savings(size());
+    for (std::size_t i=0; i<size(); i++) {
+        savings[i] = wavelets_[i]->window_size.get() - bands_[i].window_size;
+    }
+    return savings;
+}
+
+std::size_t wavelet::Filterbank::stageMemory() const
+{
+    std::size_t memory = kernel_arena_.size() * sizeof(double);
+    for (auto &plan : plans_)
+        memory += plan.kernel_arena.size() * sizeof(double);
+    for (auto &buffer : data_)
+        memory += buffer.second.capacity() * sizeof(float);
+    for (auto &filter : filters_)
+        memory += (filter.second.a.size() + filter.second.b.size() + filter.second.z.size()) * sizeof(double);
+    if (frontend_factor_ > 1)
+        memory += (frontend_filter_.a.size() + frontend_filter_.b.size() + frontend_filter_.z.size()) * sizeof(double);
+    for (auto &channel : heterodyne_) {
+        memory += (channel.baseband.capacity() + channel.envelope.size()) * sizeof(std::complex<double>);
+        memory += 2 * (channel.filter_real.a.size() + channel.filter_real.b.size() + channel.filter_real.z.size()) * sizeof(double);
+    }
+    for (auto &convolution : partitioned_) {
+        memory += convolution.history.capacity() * sizeof(float);
+        memory += (convolution.twiddles.size() + convolution.spectra.size() + convolution.spectrum.size() + convolution.outputs.size()) * sizeof(std::complex<double>);
+    }
+    return memory;
+}
+
+double wavelet::Filterbank::multipliesPerSample() const
+{
+    double multiplies(0.);
+    for (auto &filter : filters_)
+        multiplies += filter.second.a.size() + filter.second.b.size() - 1;
+    // A trous cascade: 3 multiplies per level (symmetric B3-spline kernel)
+    if (optimisation.get() == ATROUS && !data_.empty())
+        multiplies += 3. * double(data_.size() - 1);
+    for (auto const& stage : stages_) {
+        double stage_cost(0.);
+        for (std::size_t i=stage.first_band; i<stage.first_band+stage.num_bands; i++) {
+            // Skipped frames: the heterodyne channels and the partitioned convolutions still run on every sample
+            if (degradation_ >= SKIP_FRAMES && bands_[i].algorithm != BandDescriptor::HETERODYNE && bands_[i].algorithm != BandDescriptor::PARTITIONED)
+                stage_cost += bands_[i].cost / double(bands_[i].hold);
+            else
+                stage_cost += bands_[i].cost / double((optimisation.get() == AGRESSIVE) ? stage.decimation : 1);
+        }
+        multiplies += stage_cost;
+    }
+    // Front-end decimation: the stages only process one sample every front-end factor
+    if (frontend_factor_ > 1) {
+        multiplies /= double(frontend_factor_);
+        multiplies += frontend_filter_.a.size() + frontend_filter_.b.size() - 1;
+    }
+    return multiplies;
+}
+
+std::vector<double> wavelet::Filterbank::aliasingMargins() const
+{
+    std::vector<double> margins(size(), std::numeric_limits<double>::infinity());
+    double nyquist = reference_wavelet_->samplerate.get() / 2. / double(frontend_factor_);
+    for (std::size_t i=0; i<size(); i++) {
+        int factor = downsampling_factors.empty() ? 1 : downsampling_factors[i];
+        auto filter_it = filters_.find(factor);
+        if (filter_it != filters_.end())
+            margins[i] = filter_it->second.cutoff.get() * nyquist / frequencies[i];
+        else if (optimisation.get() == ATROUS && factor > 1)
+            margins[i] = nyquist / double(factor) / frequencies[i];
+        else if (frontend_factor_ > 1)
+            margins[i] = frontend_filter_.cutoff.get() * nyquist * double(frontend_factor_) / frequencies[i];
+    }
+    return margins;
+}
+
+void wavelet::Filterbank::setDecimationRates(std::vector<int> const& rates)
+{
+    for (auto rate : rates) {
+        if (rate < 1)
+            throw std::domain_error("Decimation rates must be greater or equal to 1 (got " + std::to_string(rate) + ")");
+    }
+    std::vector<int> sorted_rates(rates);
+    std::sort(sorted_rates.begin(), sorted_rates.end());
+    sorted_rates.erase(std::unique(sorted_rates.begin(), sorted_rates.end()), sorted_rates.end());
+    if (sorted_rates == decimation_rates_)
+        return;
+    decimation_rates_.swap(sorted_rates);
+    if (decimation.get() != CUSTOM)
+        return;
+    if (config_transaction_) {
+        config_changed_ = true;
+        config_full_init_ = true;
+    } else {
+        init();
+    }
+}
+
+std::vector<int> wavelet::Filterbank::getDecimationRates() const
+{
+    return decimation_rates_;
+}
+
 std::size_t wavelet::Filterbank::size() const
 {
     return wavelets_.size();
 }
 
+void wavelet::Filterbank::beginConfig()
+{
+    if (config_transaction_)
+        return;
+    config_transaction_ = true;
+    config_changed_ = false;
+    config_full_init_ = false;
+    frequency_min.set_limit_max();
+    frequency_max.set_limits(frequency_min.get_limit_min());
+}
+
+void wavelet::Filterbank::commitConfig()
+{
+    if (!config_transaction_)
+        return;
+    float nyquist = reference_wavelet_->samplerate.get() / 2.;
+    if (frequency_min.get() > frequency_max.get())
+        throw std::domain_error("frequency_min (" + std::to_string(frequency_min.get()) + ") is greater than frequency_max (" + std::to_string(frequency_max.get()) + ")");
+    if (frequency_max.get() > nyquist)
+        throw std::domain_error("frequency_max (" + std::to_string(frequency_max.get()) + ") is greater than the Nyquist frequency (" + std::to_string(nyquist) + ")");
+    frequency_min.set_limit_max(frequency_max.get());
+    frequency_max.set_limits(frequency_min.get(), nyquist);
+    config_transaction_ = false;
+    if (config_full_init_) {
+        init();
+    } else if (config_changed_) {
+        reconfigure();
+    }
+    config_changed_ = false;
+    config_full_init_ = false;
+}
+
+void wavelet::Filterbank::save(std::string const& filename) const
+{
+    std::ofstream stream(filename.c_str(), std::ios::binary | std::ios::trunc);
+    if (!stream.is_open())
+        throw std::runtime_error("Cannot open file " + filename);
+    
+    // Header
+    stream.write(snapshot_magic, sizeof(snapshot_magic));
+    write_binary(stream, snapshot_version);
+    write_binary(stream, snapshot_byte_order);
+    
+    // Attributes
+    write_binary(stream, reference_wavelet_->samplerate.get());
+    write_binary(stream, frequency_min.get());
+    write_binary(stream, frequency_max.get());
+    write_binary(stream, bands_per_octave.get());
+    write_binary(stream, static_cast<std::uint8_t>(optimisation.get()));
+    write_binary(stream, static_cast<std::uint8_t>(family.get()));
+    write_binary(stream, static_cast<std::uint8_t>(rescale.get()));
+    write_binary(stream, static_cast<std::uint8_t>(reference_wavelet_->mode.get()));
+    write_binary(stream, reference_wavelet_->delay.get());
+    write_binary(stream, reference_wavelet_->padding.get());
+    double family_parameter(0.);
+    switch (family.get()) {
+        case wavelet::MORLET:
+            family_parameter = std::static_pointer_cast<MorletWavelet>(reference_wavelet_)->omega0.get();
+            break;
+            
+        case wavelet::PAUL:
+            family_parameter = std::static_pointer_cast<PaulWavelet>(reference_wavelet_)->order.get();
+            break;
+            
+        default:
+            throw std::runtime_error("Wavelet not implemented");
+            break;
+    }
+    write_binary(stream, family_parameter);
+    write_binary(stream, accuracy.get());
+    write_binary(stream, lowrank_accuracy.get());
+    write_binary(stream, static_cast<std::uint8_t>(decimation.get()));
+    write_binary(stream, static_cast<std::uint64_t>(decimation_rates_.size()));
+    for (auto rate : decimation_rates_)
+        write_binary(stream, static_cast<std::int32_t>(rate));
+    write_binary(stream, static_cast<std::uint8_t>(predecimation.get()));
+    write_binary(stream, static_cast<std::uint32_t>(max_latency.get()));
+    
+    // Bands
+    write_binary(stream, static_cast<std::uint64_t>(wavelets_.size()));
+    for (std::size_t i=0; i<wavelets_.size(); i++) {
+        write_binary(stream, wavelets_[i]->scale.get());
+        write_binary(stream, static_cast<std::int32_t>(downsampling_factors.empty() ? 1 : downsampling_factors[i]));
+        write_binary(stream, static_cast<std::uint64_t>(wavelets_[i]->values.size()));
+        write_binary(stream, wavelets_[i]->prepad_value_);
+        write_binary(stream, wavelets_[i]->postpad_value_);
+        stream.write(reinterpret_cast<const char*>(wavelets_[i]->values.data()),
+                     wavelets_[i]->values.size() * sizeof(std::complex<double>));
+    }
+    
+    // Low-pass filters
+    write_binary(stream, static_cast<std::uint64_t>(filters_.size()));
+    for (auto &filter : filters_) {
+        write_binary(stream, static_cast<std::int32_t>(filter.first));
+        write_binary(stream, filter.second.cutoff.get());
+        write_binary(stream, static_cast<std::int32_t>(filter.second.order.get()));
+        write_binary(stream, filter.second.rippleLevel.get());
+        write_binary(stream, static_cast<std::uint64_t>(filter.second.b.size()));
+        stream.write(reinterpret_cast<const char*>(filter.second.b.data()), filter.second.b.size() * sizeof(double));
+        stream.write(reinterpret_cast<const char*>(filter.second.a.data()), filter.second.a.size() * sizeof(double));
+    }
+    
+    if (!stream.good())
+        throw std::runtime_error("Error while writing file " + filename);
+}
+
+void wavelet::Filterbank::load(std::string const& filename)
+{
+    boost::interprocess::mapped_region region;
+    try {
+        boost::interprocess::file_mapping mapping(filename.c_str(), boost::interprocess::read_only);
+        boost::interprocess::mapped_region(mapping, boost::interprocess::read_only).swap(region);
+    } catch (boost::interprocess::interprocess_exception const& e) {
+        throw std::runtime_error("Cannot open file " + filename + ": " + e.what());
+    }
+    SnapshotReader reader(static_cast<const char*>(region.get_address()), region.get_size());
+    
+    // Header
+    char magic[4];
+    reader.read(magic, sizeof(magic));
+    if (std::memcmp(magic, snapshot_magic, sizeof(magic)) != 0)
+        throw std::runtime_error(filename + " is not a filterbank snapshot");
+    if (reader.read<std::uint32_t>() != snapshot_version)
+        throw std::runtime_error("Unsupported filterbank snapshot version");
+    if (reader.read<std::uint32_t>() != snapshot_byte_order)
+        throw std::runtime_error("Filterbank snapshot was written with a different byte order");
+    
+    // Attributes
+    float samplerate_ = reader.read<float>();
+    float frequency_min_ = reader.read<float>();
+    float frequency_max_ = reader.read<float>();
+    float bands_per_octave_ = reader.read<float>();
+    Optimisation optimisation_ = static_cast<Optimisation>(reader.read<std::uint8_t>());
+    Family family_ = static_cast<Family>(reader.read<std::uint8_t>());
+    bool rescale_ = (reader.read<std::uint8_t>() != 0);
+    Wavelet::WaveletDomain mode_ = static_cast<Wavelet::WaveletDomain>(reader.read<std::uint8_t>());
+    float delay_ = reader.read<float>();
+    float padding_ = reader.read<float>();
+    double family_parameter = reader.read<double>();
+    float accuracy_ = reader.read<float>();
+    float lowrank_accuracy_ = reader.read<float>();
+    DecimationPolicy decimation_ = static_cast<DecimationPolicy>(reader.read<std::uint8_t>());
+    std::uint64_t num_rates = reader.read<std::uint64_t>();
+    if (decimation_ > CUSTOM || num_rates > reader.remaining() / sizeof(std::int32_t))
+        throw std::runtime_error("Filterbank snapshot is corrupted (invalid decimation policy)");
+    std::vector<int> decimation_rates(num_rates);
+    for (auto &rate : decimation_rates) {
+        rate = reader.read<std::int32_t>();
+        if (rate < 1)
+            throw std::runtime_error("Filterbank snapshot is corrupted (invalid decimation rate)");
+    }
+    bool predecimation_ = (reader.read<std::uint8_t>() != 0);
+    unsigned int max_latency_ = reader.read<std::uint32_t>();
+    if (!(samplerate_ > 0.) || !(frequency_min_ > 0.) || !(frequency_min_ <= frequency_max_) ||
+        !(frequency_max_ <= samplerate_ / 2.) || !(bands_per_octave_ >= 1.) || optimisation_ > ATROUS ||
+        !(accuracy_ <= 0.) || !(lowrank_accuracy_ <= 0.))
+        throw std::runtime_error("Filterbank snapshot is corrupted (invalid attributes)");
+    
+    std::shared_ptr<Wavelet> reference_wavelet;
+    switch (family_) {
+        case wavelet::MORLET:
+            reference_wavelet = std::shared_ptr<MorletWavelet>(new MorletWavelet(samplerate_));
+            std::static_pointer_cast<MorletWavelet>(reference_wavelet)->omega0.set(static_cast<float>(family_parameter), true);
+            break;
+            
+        case wavelet::PAUL:
+            reference_wavelet = std::shared_ptr<PaulWavelet>(new PaulWavelet(samplerate_));
+            std::static_pointer_cast<PaulWavelet>(reference_wavelet)->order.set(static_cast<unsigned int>(family_parameter), true);
+            break;
+            
+        default:
+            throw std::runtime_error("Filterbank snapshot is corrupted (unknown wavelet family)");
+            break;
+    }
+    reference_wavelet->setKernelCache(reference_wavelet_->getKernelCache());
+    reference_wavelet->mode.set(mode_, true);
+    reference_wavelet->delay.set(delay_, true);
+    reference_wavelet->padding.set(padding_, true);
+    
+    int frontend_factor = frontend_decimation(predecimation_, samplerate_, frequency_max_);
+    
+    // Bands
+    std::uint64_t num_bands = reader.read<std::uint64_t>();
+    if (num_bands > reader.remaining())
+        throw std::runtime_error("Filterbank snapshot is corrupted (invalid number of bands)");
+    std::vector< std::shared_ptr<Wavelet> > wavelets(num_bands);
+    std::vector<double> scales_(num_bands);
+    std::vector<double> frequencies_(num_bands);
+    std::vector<int> downsampling_factors_(num_bands);
+    for (std::size_t i=0; i<num_bands; i++) {
+        scales_[i] = reader.read<double>();
+        frequencies_[i] = reference_wavelet->scale2frequency(scales_[i]);
+        downsampling_factors_[i] = reader.read<std::int32_t>();
+        std::uint64_t window_size_ = reader.read<std::uint64_t>();
+        if (downsampling_factors_[i] < 1 || window_size_ < 1 ||
+            window_size_ > reader.remaining() / sizeof(std::complex<double>))
+            throw std::runtime_error("Filterbank snapshot is corrupted (invalid band)");
+        switch (family_) {
+            case wavelet::MORLET:
+                wavelets[i] = std::shared_ptr<MorletWavelet>(new MorletWavelet(*std::static_pointer_cast<MorletWavelet>(reference_wavelet)));
+                break;
+                
+            case wavelet::PAUL:
+                wavelets[i] = std::shared_ptr<PaulWavelet>(new PaulWavelet(*std::static_pointer_cast<PaulWavelet>(reference_wavelet)));
+                break;
+                
+            default:
+                break;
+        }
+        wavelets[i]->samplerate.set(samplerate_ / float(frontend_factor * downsampling_factors_[i]), true);
+        wavelets[i]->scale.set(scales_[i], true);
+        wavelets[i]->window_size.set(static_cast<std::size_t>(window_size_), true);
+        wavelets[i]->prepad_value_ = reader.read< std::complex<double> >();
+        wavelets[i]->postpad_value_ = reader.read< std::complex<double> >();
+        wavelets[i]->values.resize(window_size_);
+        reader.read(wavelets[i]->values.data(), window_size_ * sizeof(std::complex<double>));
+    }
+    
+    // Low-pass filters
+    std::uint64_t num_filters = reader.read<std::uint64_t>();
+    if (num_filters > reader.remaining())
+        throw std::runtime_error("Filterbank snapshot is corrupted (invalid number of filters)");
+    std::map<int, LowpassFilter> filters;
+    for (std::size_t i=0; i<num_filters; i++) {
+        int factor = reader.read<std::int32_t>();
+        double cutoff = reader.read<double>();
+        int order = reader.read<std::int32_t>();
+        double ripple_level = reader.read<double>();
+        std::uint64_t num_coefficients = reader.read<std::uint64_t>();
+        if (order < 1 || num_coefficients != static_cast<std::uint64_t>(order) + 1)
+            throw std::runtime_error("Filterbank snapshot is corrupted (invalid low-pass filter)");
+        LowpassFilter &filter = filters[factor];
+        filter.cutoff.set(cutoff, true);
+        filter.order.set(order, true);
+        filter.rippleLevel.set(ripple_level, true);
+        filter.b.resize(num_coefficients);
+        filter.a.resize(num_coefficients);
+        reader.read(filter.b.data(), num_coefficients * sizeof(double));
+        reader.read(filter.a.data(), num_coefficients * sizeof(double));
+        filter.z.assign(order, 0.);
+    }
+    
+    // Commit
+    reference_wavelet_ = reference_wavelet;
+    frequency_min.set_limits(1e-12, frequency_max_);
+    frequency_min.set(frequency_min_, true);
+    frequency_max.set_limits(frequency_min_, samplerate_ / 2.);
+    frequency_max.set(frequency_max_, true);
+    bands_per_octave.set(bands_per_octave_, true);
+    optimisation.set(optimisation_, true);
+    family.set(family_, true);
+    rescale.set(rescale_, true);
+    accuracy.set(accuracy_, true);
+    lowrank_accuracy.set(lowrank_accuracy_, true);
+    decimation.set(decimation_, true);
+    decimation_rates_.swap(decimation_rates);
+    predecimation.set(predecimation_, true);
+    max_latency.set(max_latency_, true);
+    frontend_factor_ = frontend_factor;
+    if (frontend_factor_ > 1)
+        frontend_filter_ = LowpassFilter(0.8 / double(frontend_factor_));
+    frontend_index_ = 0;
+    config_transaction_ = false;
+    config_changed_ = false;
+    config_full_init_ = false;
+    wavelets_.swap(wavelets);
+    scales.swap(scales_);
+    frequencies.swap(frequencies_);
+    if (!decimated_stages(optimisation.get()))
+        downsampling_factors.clear();
+    else
+        downsampling_factors.swap(downsampling_factors_);
+    filters_.swap(filters);
+    data_.clear();
+    result_complex.assign(wavelets_.size(), std::complex<double>(0.0));
+    result_power.assign(wavelets_.size(), 0.0);
+    frame_index_ = 0;
+    initStages();
+}
+
+std::vector<char> wavelet::Filterbank::saveState() const
+{
+    std::vector<char> state;
+    state.insert(state.end(), state_magic, state_magic + sizeof(state_magic));
+    write_binary(state, state_version);
+    write_binary(state, configurationFingerprint());
+    write_binary(state, static_cast<std::int64_t>(frame_index_));
+    
+    // Front-end stage
+    write_binary(state, static_cast<std::uint64_t>(frontend_index_));
+    write_binary(state, static_cast<std::uint64_t>(frontend_filter_.z.size()));
+    for (auto &value : frontend_filter_.z)
+        write_binary(state, value);
+    
+    // Data buffers
+    write_binary(state, static_cast<std::uint64_t>(data_.size()));
+    for (auto &buffer : data_) {
+        write_binary(state, static_cast<std::int32_t>(buffer.first));
+        write_binary(state, static_cast<std::uint64_t>(buffer.second.capacity()));
+        write_binary(state, static_cast<std::uint64_t>(buffer.second.size()));
+        for (auto &value : buffer.second)
+            write_binary(state, value);
+    }
+    write_binary(state, static_cast<std::uint64_t>(data_latest_.size()));
+    for (auto &latest : data_latest_) {
+        write_binary(state, static_cast<std::int32_t>(latest.first));
+        write_binary(state, latest.second);
+    }
+    
+    // Low-pass filters memory
+    write_binary(state, static_cast<std::uint64_t>(filters_.size()));
+    for (auto &filter : filters_) {
+        write_binary(state, static_cast<std::int32_t>(filter.first));
+        write_binary(state, static_cast<std::uint64_t>(filter.second.z.size()));
+        for (auto &value : filter.second.z)
+            write_binary(state, value);
+    }
+    
+    // Heterodyne channels
+    write_binary(state, static_cast<std::uint64_t>(heterodyne_.size()));
+    for (auto &channel : heterodyne_) {
+        write_binary(state, static_cast<std::uint64_t>(channel.index));
+        write_binary(state, channel.phasor);
+        write_binary(state, channel.result);
+        for (auto &value : channel.filter_real.z)
+            write_binary(state, value);
+        for (auto &value : channel.filter_imag.z)
+            write_binary(state, value);
+        for (auto &value : channel.baseband)
+            write_binary(state, value);
+    }
+    
+    // Partitioned convolutions (their spectra are recomputed from the history)
+    write_binary(state, static_cast<std::uint64_t>(partitioned_.size()));
+    for (auto &convolution : partitioned_) {
+        write_binary(state, static_cast<std::uint64_t>(convolution.count));
+        write_binary(state, static_cast<std::uint64_t>(convolution.history.size()));
+        for (auto &value : convolution.history)
+            write_binary(state, value);
+    }
+    
+    // Results
+    write_binary(state, static_cast<std::uint64_t>(result_complex.size()));
+    for (auto &value : result_complex)
+        write_binary(state, value);
+    
+    return state;
+}
+
+void wavelet::Filterbank::restoreState(std::vector<char> const& state)
+{
+    SnapshotReader reader(state.data(), state.size());
+    char magic[4];
+    reader.read(magic, sizeof(magic));
+    if (std::memcmp(magic, state_magic, sizeof(magic)) != 0)
+        throw std::runtime_error("Invalid filterbank state");
+    if (reader.read<std::uint32_t>() != state_version)
+        throw std::runtime_error("Unsupported filterbank state version");
+    if (reader.read<std::uint64_t>() != configurationFingerprint())
+        throw std::runtime_error("Filterbank state was saved with a different configuration");
+    std::int64_t frame_index = reader.read<std::int64_t>();
+    
+    // Front-end stage
+    std::uint64_t frontend_index = reader.read<std::uint64_t>();
+    if (reader.read<std::uint64_t>() != frontend_filter_.z.size())
+        throw std::runtime_error("Filterbank state is corrupted (invalid front-end filter)");
+    std::vector<double> frontend_memory(frontend_filter_.z.size());
+    reader.read(frontend_memory.data(), frontend_memory.size() * sizeof(double));
+    
+    // Data buffers
+    if (reader.read<std::uint64_t>() != data_.size())
+        throw std::runtime_error("Filterbank state is corrupted (invalid number of buffers)");
+    std::vector< std::vector<float> > buffers;
+    for (auto &buffer : data_) {
+        std::uint64_t capacity, size;
+        if (reader.read<std::int32_t>() != buffer.first)
+            throw std::runtime_error("Filterbank state is corrupted (invalid buffer)");
+        capacity = reader.read<std::uint64_t>();
+        size = reader.read<std::uint64_t>();
+        if (capacity != buffer.second.capacity() || size > capacity)
+            throw std::runtime_error("Filterbank state is corrupted (invalid buffer)");
+        if (size > reader.remaining() / sizeof(float))
+            throw std::runtime_error("Filterbank state is corrupted (unexpected end of data)");
+        buffers.push_back(std::vector<float>(size));
+        reader.read(buffers.back().data(), size * sizeof(float));
+    }
+    if (reader.read<std::uint64_t>() != data_latest_.size())
+        throw std::runtime_error("Filterbank state is corrupted (invalid number of buffers)");
+    std::vector<float> latest_values;
+    for (auto &latest : data_latest_) {
+        if (reader.read<std::int32_t>() != latest.first)
+            throw std::runtime_error("Filterbank state is corrupted (invalid buffer)");
+        latest_values.push_back(reader.read<float>());
+    }
+    
+    // Low-pass filters memory
+    if (reader.read<std::uint64_t>() != filters_.size())
+        throw std::runtime_error("Filterbank state is corrupted (invalid number of filters)");
+    std::vector< std::vector<double> > filters_memory;
+    for (auto &filter : filters_) {
+        if (reader.read<std::int32_t>() != filter.first ||
+            reader.read<std::uint64_t>() != filter.second.z.size())
+            throw std::runtime_error("Filterbank state is corrupted (invalid filter)");
+        filters_memory.push_back(std::vector<double>(filter.second.z.size()));
+        reader.read(filters_memory.back().data(), filter.second.z.size() * sizeof(double));
+    }
+    
+    // Heterodyne channels (their sizes are set by the configuration)
+    if (reader.read<std::uint64_t>() != heterodyne_.size())
+        throw std::runtime_error("Filterbank state is corrupted (invalid number of heterodyne channels)");
+    std::vector<HeterodyneChannel> channels(heterodyne_);
+    for (auto &channel : channels) {
+        channel.index = static_cast<std::size_t>(reader.read<std::uint64_t>());
+        channel.phasor = reader.read< std::complex<double> >();
+        channel.result = reader.read< std::complex<double> >();
+        reader.read(channel.filter_real.z.data(), channel.filter_real.z.size() * sizeof(double));
+        reader.read(channel.filter_imag.z.data(), channel.filter_imag.z.size() * sizeof(double));
+        for (auto &value : channel.baseband)
+            value = reader.read< std::complex<double> >();
+    }
+    
+    // Partitioned convolutions
+    if (reader.read<std::uint64_t>() != partitioned_.size())
+        throw std::runtime_error("Filterbank state is corrupted (invalid number of partitioned convolutions)");
+    std::vector< std::vector<float> > histories;
+    std::vector<std::size_t> counts;
+    for (auto &convolution : partitioned_) {
+        std::uint64_t count = reader.read<std::uint64_t>();
+        std::uint64_t size = reader.read<std::uint64_t>();
+        if (count >= convolution.block_size || (size != 0 && size != convolution.history.capacity()))
+            throw std::runtime_error("Filterbank state is corrupted (invalid partitioned convolution)");
+        if (size > reader.remaining() / sizeof(float))
+            throw std::runtime_error("Filterbank state is corrupted (unexpected end of data)");
+        histories.push_back(std::vector<float>(size));
+        reader.read(histories.back().data(), size * sizeof(float));
+        counts.push_back(static_cast<std::size_t>(count));
+    }
+    
+    // Results
+    if (reader.read<std::uint64_t>() != result_complex.size())
+        throw std::runtime_error("Filterbank state is corrupted (invalid number of bands)");
+    std::vector< std::complex<double> > results(result_complex.size());
+    reader.read(results.data(), results.size() * sizeof(std::complex<double>));
+    
+    // Commit
+    std::size_t index(0);
+    for (auto &buffer : data_) {
+        buffer.second.clear();
+        buffer.second.insert(buffer.second.end(), buffers[index].begin(), buffers[index].end());
+        index++;
+    }
+    index = 0;
+    for (auto &latest : data_latest_) {
+        latest.second = latest_values[index++];
+    }
+    index = 0;
+    for (auto &filter : filters_) {
+        filter.second.z.swap(filters_memory[index++]);
+    }
+    heterodyne_.swap(channels);
+    index = 0;
+    for (auto &convolution : partitioned_) {
+        convolution.history.clear();
+        convolution.history.insert(convolution.history.end(), histories[index].begin(), histories[index].end());
+        convolution.count = counts[index++];
+        if (convolution.history.full())
+            updatePartitions(convolution, convolution.num_partitions);
+    }
+    result_complex.swap(results);
+    for (std::size_t i=0; i<result_complex.size(); i++) {
+        result_power[i] = std::norm(result_complex[i]);
+    }
+    frame_index_ = static_cast<int>(frame_index);
+    frontend_index_ = static_cast<std::size_t>(frontend_index);
+    frontend_filter_.z.swap(frontend_memory);
+}
+
+std::uint64_t wavelet::Filterbank::configurationFingerprint() const
+{
+    std::uint64_t hash(14695981039346656037ULL);
+    hash_combine(hash, reference_wavelet_->samplerate.get());
+    hash_combine(hash, frequency_min.get());
+    hash_combine(hash, frequency_max.get());
+    hash_combine(hash, bands_per_octave.get());
+    hash_combine(hash, optimisation.get());
+    hash_combine(hash, family.get());
+    hash_combine(hash, rescale.get());
+    hash_combine(hash, reference_wavelet_->mode.get());
+    hash_combine(hash, reference_wavelet_->delay.get());
+    hash_combine(hash, reference_wavelet_->padding.get());
+    hash_combine(hash, accuracy.get());
+    hash_combine(hash, lowrank_accuracy.get());
+    hash_combine(hash, max_latency.get());
+    hash_combine(hash, decimation.get());
+    hash_combine(hash, frontend_factor_);
+    switch (family.get()) {
+        case wavelet::MORLET:
+            hash_combine(hash, std::static_pointer_cast<MorletWavelet>(reference_wavelet_)->omega0.get());
+            break;
+            
+        case wavelet::PAUL:
+            hash_combine(hash, std::static_pointer_cast<PaulWavelet>(reference_wavelet_)->order.get());
+            break;
+            
+        default:
+            break;
+    }
+    for (std::size_t i=0; i<wavelets_.size(); i++) {
+        hash_combine(hash, wavelets_[i]->scale.get());
+        hash_combine(hash, wavelets_[i]->window_size.get());
+        hash_combine(hash, downsampling_factors.empty() ? 1 : downsampling_factors[i]);
+    }
+    return hash;
+}
+
 void wavelet::Filterbank::onAttributeChange(AttributeBase* attr_pointer)
 {
+    if (attr_pointer == &threads) {
+        attr_pointer->changed = false;
+        return;
+    }
+    if (attr_pointer == &cpu_budget) {
+        attr_pointer->changed = false;
+        degradation_speedups_.assign(SHORTER_KERNELS + 1, 0.);
+        cpu_load_ = 0.;
+        setDegradation(NOMINAL);
+        // The plans of the degradation levels are only prebuilt under a budget
+        bool prebuilt = (plans_.size() > SHORTER_KERNELS && !plans_[SHORTER_KERNELS].bands.empty());
+        if (!wavelets_.empty() && prebuilt != (cpu_budget.get() > 0.)) {
+            if (config_transaction_)
+                config_changed_ = true;
+            else
+                packKernels();
+        }
+        return;
+    }
+    if (attr_pointer == &accuracy || attr_pointer == &lowrank_accuracy || attr_pointer == &max_latency) {
+        attr_pointer->changed = false;
+        if (config_transaction_)
+            config_changed_ = true;
+        else
+            packKernels();
+        return;
+    }
     if (attr_pointer == &family) {
         float samplerate = reference_wavelet_->samplerate.get();
+        std::shared_ptr<KernelCache> kernel_cache = reference_wavelet_->getKernelCache();
         switch (family.get()) {
             case wavelet::MORLET:
                 reference_wavelet_ = std::unique_ptr<MorletWavelet>(new MorletWavelet(samplerate));
@@ -163,62 +1313,98 @@ void wavelet::Filterbank::onAttributeChange(AttributeBase* attr_pointer)
                 throw std::runtime_error("Wavelet not implemented");
                 break;
         }
+        reference_wavelet_->setKernelCache(kernel_cache);
+    }
+    if (!config_transaction_) {
+        if (attr_pointer == &frequency_min) {
+            frequency_max.set_limit_min(frequency_min.get());
+        } else if (attr_pointer == &frequency_max) {
+            frequency_min.set_limit_max(frequency_max.get());
+        } else if (attr_pointer == &reference_wavelet_->samplerate) {
+            frequency_max.set_limit_max(reference_wavelet_->samplerate.get() / 2.);
+        }
     }
-    init();
     attr_pointer->changed = false;
-}
-
-void wavelet::Filterbank::setAttribute_internal(std::string attr_name,
-                                                boost::any const& attr_value)
-{
-    if (attr_name == "frequency_min") {
-        frequency_min.set(boost::any_cast<float>(attr_value));
-        frequency_max.set_limit_min(frequency_min.get());
-    } else if (attr_name == "frequency_max") {
-        frequency_max.set(boost::any_cast<float>(attr_value));
-        frequency_min.set_limit_max(frequency_max.get());
-    } else if (attr_name == "bands_per_octave") {
-        bands_per_octave.set(boost::any_cast<float>(attr_value));
-    } else if (attr_name == "family") {
-        family.set(boost::any_cast<Family>(attr_value));
-    } else if (attr_name == "optimisation") {
-        optimisation.set(boost::any_cast<Optimisation>(attr_value));
-    } else if (attr_name == "rescale") {
-        rescale.set(boost::any_cast<bool>(attr_value));
+    bool bands_only = (attr_pointer == &frequency_min ||
+                       attr_pointer == &frequency_max ||
+                       attr_pointer == &bands_per_octave ||
+                       attr_pointer == &rescale);
+    if (config_transaction_) {
+        config_changed_ = true;
+        config_full_init_ = config_full_init_ || !bands_only;
+    } else if (bands_only) {
+        reconfigure();
     } else {
-        if (attr_name != "scale" && attr_name != "window_size") {
-            reference_wavelet_->setAttribute(attr_name, attr_value);
-            if (attr_name == "samplerate") {
-                frequency_max.set_limit_max(boost::any_cast<float>(attr_value) / 2.);
-            }
-        } else {
-            throw std::runtime_error("Attribute " + attr_name + " does not exist or is not shared among filters.");
-        }
         init();
     }
 }
 
-boost::any wavelet::Filterbank::getAttribute_internal(std::string attr_name) const
+wavelet::AttributeBase* wavelet::Filterbank::attribute(AttributeId attr_id)
 {
-    if (attr_name == "frequency_min")
-        return boost::any(frequency_min.get());
-    if (attr_name == "frequency_max")
-        return boost::any(frequency_max.get());
-    if (attr_name == "bands_per_octave")
-        return boost::any(bands_per_octave.get());
-    if (attr_name == "optimisation")
-        return boost::any(optimisation.get());
-    if (attr_name == "family")
-        return boost::any(family.get());
-    if (attr_name == "rescale")
-        return boost::any(rescale.get());
-    if (attr_name != "scale" && attr_name != "window_size")
-        return reference_wavelet_->getAttribute_internal(attr_name);
-    throw std::runtime_error("Attribute " + attr_name + "does not exist or is not shared among filters.");
+    switch (attr_id) {
+        case ATTR_FREQUENCY_MIN:
+            return &frequency_min;
+        case ATTR_FREQUENCY_MAX:
+            return &frequency_max;
+        case ATTR_BANDS_PER_OCTAVE:
+            return &bands_per_octave;
+        case ATTR_OPTIMISATION:
+            return &optimisation;
+        case ATTR_FAMILY:
+            return &family;
+        case ATTR_RESCALE:
+            return &rescale;
+        case ATTR_THREADS:
+            return &threads;
+        case ATTR_ACCURACY:
+            return &accuracy;
+        case ATTR_LOWRANK_ACCURACY:
+            return &lowrank_accuracy;
+        case ATTR_DECIMATION:
+            return &decimation;
+        case ATTR_PREDECIMATION:
+            return &predecimation;
+        case ATTR_CPU_BUDGET:
+            return &cpu_budget;
+        case ATTR_MAX_LATENCY:
+            return &max_latency;
+        case ATTR_SCALE:
+        case ATTR_WINDOW_SIZE:
+            return nullptr;
+        default:
+            return reference_wavelet_->attribute(attr_id);
+    }
 }
 
 void wavelet::Filterbank::init()
 {
+    wavelets_.clear();
+    data_.clear();
+    filters_.clear();
+    result_complex.clear();
+    result_power.clear();
+    frame_index_ = 0;
+    frontend_factor_ = 0;
+    reconfigure();
+}
+
+void wavelet::Filterbank::reconfigure()
+{
+    // Front-end decimation: a new factor changes the sampling rate of all bands, which are reinitialized
+    int frontend_factor = frontend_decimation(predecimation.get(), reference_wavelet_->samplerate.get(), frequency_max.get());
+    if (frontend_factor != frontend_factor_) {
+        frontend_factor_ = frontend_factor;
+        frontend_filter_ = LowpassFilter((frontend_factor_ > 1) ? 0.8 / double(frontend_factor_) : 1.);
+        frontend_index_ = 0;
+        wavelets_.clear();
+        data_.clear();
+        filters_.clear();
+        result_complex.clear();
+        result_power.clear();
+        frame_index_ = 0;
+    }
+    double samplerate = reference_wavelet_->samplerate.get() / double(frontend_factor_);
+    
     // Compute Scales of the Filterbank
     double scale_0 = 2. / reference_wavelet_->samplerate.get();
     double min_scale = reference_wavelet_->frequency2scale(frequency_max.get());
@@ -234,63 +1420,673 @@ void wavelet::Filterbank::init()
         scales[i] = scale_0 * pow(2., double(scale_index) / bands_per_octave.get());
         frequencies[i] = reference_wavelet_->scale2frequency(scales[i]);
     }
-    if (optimisation.get() != NONE) {
+    downsampling_factors.clear();
+    if (decimated_stages(optimisation.get())) {
         downsampling_factors.resize(max_index - min_index);
         for (long scale_index=min_index, i=0; scale_index<max_index; scale_index++, i++) {
-            double samplerate_ratio = (reference_wavelet_->samplerate.get() / 4) / frequencies[i];
-            // downsampling_factors[i] = static_cast<int>(pow(2, int(log2(int(samplerate_ratio)))));
-            downsampling_factors[i] = static_cast<int>(samplerate_ratio);
-            downsampling_factors[i] = (downsampling_factors[i] > 1) ? downsampling_factors[i] : 1;
+            double samplerate_ratio = (samplerate / 4) / frequencies[i];
+            downsampling_factors[i] = quantizeDownsamplingFactor(samplerate_ratio);
         }
     }
     
-    // Allocate and initialize wavelets
-    switch (family.get()) {
-        case wavelet::MORLET:
-            wavelets_.resize(max_index - min_index);
-            for (unsigned int i =0; i < scales.size() ; i++) {
+    // Allocate and initialize wavelets (bands with the same scale are kept with their results)
+    std::vector< std::shared_ptr<Wavelet> > previous_wavelets;
+    std::vector< std::complex<double> > previous_result_complex;
+    std::vector<double> previous_result_power;
+    previous_wavelets.swap(wavelets_);
+    previous_result_complex.swap(result_complex);
+    previous_result_power.swap(result_power);
+    wavelets_.resize(scales.size());
+    result_complex.assign(scales.size(), std::complex<double>(0.0));
+    result_power.assign(scales.size(), 0.0);
+    std::vector<std::size_t> new_bands;
+    std::size_t previous_index(0);
+    for (unsigned int i =0; i < scales.size() ; i++) {
+        while (previous_index < previous_wavelets.size() && previous_wavelets[previous_index]->scale.get() < scales[i])
+            previous_index++;
+        if (previous_index < previous_wavelets.size() && previous_wavelets[previous_index]->scale.get() == scales[i]) {
+            wavelets_[i] = previous_wavelets[previous_index];
+            result_complex[i] = previous_result_complex[previous_index];
+            result_power[i] = previous_result_power[previous_index];
+            continue;
+        }
+        switch (family.get()) {
+            case wavelet::MORLET:
                 wavelets_[i] = std::shared_ptr<MorletWavelet>(new MorletWavelet(*std::static_pointer_cast<MorletWavelet>(reference_wavelet_)));
-                if (optimisation.get() != NONE)
-                    wavelets_[i]->samplerate.set(reference_wavelet_->samplerate.get() / double(downsampling_factors[i]));
-                wavelets_[i]->scale.set(scales[i]);
-                wavelets_[i]->setDefaultWindowsize();
-            }
-            break;
-            
-        case wavelet::PAUL:
-            wavelets_.resize(max_index - min_index);
-            for (unsigned int i =0; i < scales.size() ; i++) {
+                break;
+                
+            case wavelet::PAUL:
                 wavelets_[i] = std::shared_ptr<PaulWavelet>(new PaulWavelet(*std::static_pointer_cast<PaulWavelet>(reference_wavelet_)));
-                if (optimisation.get() != NONE)
-                    wavelets_[i]->samplerate.set(reference_wavelet_->samplerate.get() / double(downsampling_factors[i]));
-                wavelets_[i]->scale.set(scales[i]);
-                wavelets_[i]->setDefaultWindowsize();
-            }
-            break;
+                break;
+                
+            default:
+                throw std::runtime_error("Wavelet not implemented");
+                break;
+        }
+        if (decimated_stages(optimisation.get()))
+            wavelets_[i]->samplerate.set(samplerate / double(downsampling_factors[i]), true);
+        else
+            wavelets_[i]->samplerate.set(samplerate, true);
+        wavelets_[i]->scale.set(scales[i], true);
+        wavelets_[i]->setDefaultWindowsize(true);
+        new_bands.push_back(i);
+    }
+    
+    // New bands whose kernel already exists in another octave copy it instead of computing it
+    std::vector<bool> available(wavelets_.size(), true);
+    for (auto band_index : new_bands)
+        available[band_index] = false;
+    std::vector<std::size_t> computed_bands;
+    std::vector< std::pair<std::size_t, std::size_t> > shared_bands;
+    for (auto band_index : new_bands) {
+        std::size_t source(0);
+        while (source < wavelets_.size() && !(available[source] && same_kernel(*wavelets_[band_index], *wavelets_[source])))
+            source++;
+        if (source < wavelets_.size()) {
+            shared_bands.push_back(std::make_pair(band_index, source));
+        } else {
+            computed_bands.push_back(band_index);
+            available[band_index] = true;
+        }
+    }
+    initWavelets(computed_bands);
+    for (auto &shared : shared_bands) {
+        wavelets_[shared.first]->values = wavelets_[shared.second]->values;
+        wavelets_[shared.first]->prepad_value_ = wavelets_[shared.second]->prepad_value_;
+        wavelets_[shared.first]->postpad_value_ = wavelets_[shared.second]->postpad_value_;
+    }
+    
+    initStages();
+}
+
+int wavelet::Filterbank::quantizeDownsamplingFactor(double samplerate_ratio) const
+{
+    int factor = (samplerate_ratio > 1.) ? static_cast<int>(samplerate_ratio) : 1;
+    // The a trous cascade only provides dyadic levels, one below the largest factor to keep the band in the flat part of the B3-spline filters
+    if (optimisation.get() == ATROUS)
+        return std::max(1, (1 << static_cast<int>(log2(factor))) / 2);
+    switch (decimation.get()) {
+        case POW2:
+            return 1 << static_cast<int>(log2(factor));
+            
+        case CUSTOM: {
+            auto rate_it = std::upper_bound(decimation_rates_.begin(), decimation_rates_.end(), factor);
+            return (rate_it == decimation_rates_.begin()) ? 1 : *(rate_it - 1);
+        }
             
         default:
-            throw std::runtime_error("Wavelet not implemented");
-            break;
+            return factor;
     }
-    
-  
-    data_.clear();
-    filters_.clear();
-    if (optimisation.get() == NONE) {
-        data_[1].resize(wavelets_[wavelets_.size() - 1]->window_size.get());
-        downsampling_factors.clear();
+}
+
+void wavelet::Filterbank::initWavelets(std::vector<std::size_t> const& band_indices)
+{
+    std::size_t num_threads = std::min(static_cast<std::size_t>(threads.get()), band_indices.size());
+    if (num_threads <= 1) {
+        for (auto band_index : band_indices)
+            wavelets_[band_index]->init();
+        return;
+    }
+    // Bands are interleaved among threads to balance the load (window sizes grow with the band index)
+    std::vector<std::thread> workers;
+    std::vector<std::exception_ptr> errors(num_threads);
+    for (std::size_t thread_index=0; thread_index<num_threads; thread_index++) {
+        workers.push_back(std::thread([this, &band_indices, &errors, num_threads, thread_index] {
+            try {
+                for (std::size_t i=thread_index; i<band_indices.size(); i+=num_threads)
+                    wavelets_[band_indices[i]]->init();
+            } catch (...) {
+                errors[thread_index] = std::current_exception();
+            }
+        }));
+    }
+    for (auto &worker : workers)
+        worker.join();
+    for (auto &error : errors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+}
+
+void wavelet::Filterbank::initStages()
+{
+    // Decimation stages: keep the buffers and filter memory of the remaining stages
+    std::map<int, std::size_t> capacities;
+    if (!decimated_stages(optimisation.get())) {
+        if (!wavelets_.empty())
+            capacities[1] = wavelets_[wavelets_.size() - 1]->window_size.get();
     } else {
+        // Agressive mode: the decimated stages are stored at their decimated rate
         for (unsigned int i=0; i<wavelets_.size(); i++) {
-            data_[downsampling_factors[i]].resize(wavelets_[i]->window_size.get() * downsampling_factors[i]);
-            data_[downsampling_factors[i]].clear();
-            if ((downsampling_factors[i] > 1) && (filters_.count(downsampling_factors[i]) == 0)) {
-                filters_[downsampling_factors[i]].cutoff.set(0.8/double(downsampling_factors[i]));
+            std::size_t capacity = wavelets_[i]->window_size.get();
+            if (optimisation.get() != AGRESSIVE)
+                capacity *= downsampling_factors[i];
+            capacities[downsampling_factors[i]] = std::max(capacities[downsampling_factors[i]], capacity);
+        }
+        // A trous cascade: every level up to the largest factor, holding the taps of the next dilated kernel
+        if (optimisation.get() == ATROUS && !capacities.empty()) {
+            int max_factor = capacities.rbegin()->first;
+            for (int factor=1; factor<=max_factor; factor*=2)
+                capacities[factor] = std::max(capacities[factor], std::size_t(4 * factor + 1));
+        }
+    }
+    for (auto data_it = data_.begin(); data_it != data_.end(); ) {
+        if (capacities.count(data_it->first) == 0)
+            data_it = data_.erase(data_it);
+        else
+            data_it++;
+    }
+    for (auto latest_it = data_latest_.begin(); latest_it != data_latest_.end(); ) {
+        if (capacities.count(latest_it->first) == 0 || optimisation.get() != AGRESSIVE)
+            latest_it = data_latest_.erase(latest_it);
+        else
+            latest_it++;
+    }
+    for (auto filters_it = filters_.begin(); filters_it != filters_.end(); ) {
+        if (capacities.count(filters_it->first) == 0 || optimisation.get() == ATROUS)
+            filters_it = filters_.erase(filters_it);
+        else
+            filters_it++;
+    }
+    for (auto &capacity : capacities) {
+        if (data_.count(capacity.first) > 0) {
+            resizeKeepingHistory(data_[capacity.first], capacity.second);
+        } else {
+            data_[capacity.first].set_capacity(capacity.second);
+            if (!decimated_stages(optimisation.get()))
+                data_[capacity.first].resize(capacity.second);
+        }
+        if ((capacity.first > 1) && (optimisation.get() != ATROUS) && (filters_.count(capacity.first) == 0)) {
+            filters_[capacity.first].cutoff.set(0.8/double(capacity.first));
+        }
+        if ((capacity.first > 1) && (optimisation.get() == AGRESSIVE) && (data_latest_.count(capacity.first) == 0)) {
+            data_latest_[capacity.first] = 0.;
+        }
+    }
+    packKernels();
+}
+
+void wavelet::Filterbank::packKernels()
+{
+    auto count_gathered_bands = [this]() {
+        for (auto &stage : stages_) {
+            stage.gathered_bands = 0;
+            for (std::size_t i=stage.first_band; i<stage.first_band+stage.num_bands; i++) {
+                if (bands_[i].algorithm != BandDescriptor::HETERODYNE && bands_[i].algorithm != BandDescriptor::PARTITIONED)
+                    stage.gathered_bands++;
             }
         }
+    };
+    
+    // Nominal plan, and the heterodyne channels and partitioned convolutions shared by all degradation levels
+    plans_.assign(SHORTER_KERNELS + 1, KernelPlan());
+    planKernels(NOMINAL, nullptr);
+    heterodyne_.clear();
+    if (optimisation.get() == HETERODYNE)
+        initHeterodyne();
+    count_gathered_bands();
+    std::size_t max_length(0);
+    std::size_t max_rank(0);
+    for (auto const& stage : stages_) {
+        max_length = std::max(max_length, stage.length);
+        max_rank = std::max(max_rank, stage.rank);
     }
-    frame_index_ = 0;
-    result_complex.assign(wavelets_.size(), std::complex<double>(0.0));
-    result_power.assign(wavelets_.size(), 0.0);
+    stage_samples_.assign(max_length, 0.);
+    
+    // Streaming states of the partitioned stages, started from the history of their data buffer
+    partitioned_.clear();
+    for (std::size_t stage_index=0; stage_index<stages_.size(); stage_index++) {
+        StageDescriptor const& stage = stages_[stage_index];
+        std::size_t num_partitions(0);
+        for (std::size_t i=stage.first_band; i<stage.first_band+stage.num_bands; i++) {
+            if (bands_[i].algorithm == BandDescriptor::PARTITIONED)
+                num_partitions = std::max(num_partitions, bands_[i].partitions);
+        }
+        if (num_partitions == 0)
+            continue;
+        PartitionedConvolution convolution;
+        convolution.stage = stage_index;
+        convolution.block_size = stage.block_size;
+        convolution.num_partitions = num_partitions;
+        // Frames of the delay line at any time of the block, and pre-padding sample of the delayed outputs
+        std::size_t capacity = std::max((num_partitions + 2) * stage.block_size - 1, stage.buffer->capacity() + stage.block_size - 1);
+        convolution.history.set_capacity(capacity);
+        if (!stage.buffer->empty()) {
+            convolution.history.resize(capacity - stage.buffer->size(), stage.buffer->front());
+            convolution.history.insert(convolution.history.end(), stage.buffer->begin(), stage.buffer->end());
+        }
+        convolution.count = 0;
+        convolution.twiddles = fft_twiddles(2 * stage.block_size);
+        convolution.spectra.assign(num_partitions * 2 * stage.block_size, std::complex<double>(0., 0.));
+        convolution.head = 0;
+        convolution.spectrum.assign(2 * stage.block_size, std::complex<double>(0., 0.));
+        convolution.outputs.assign(stage.num_bands * stage.block_size, std::complex<double>(0., 0.));
+        partitioned_.push_back(convolution);
+        if (!partitioned_.back().history.empty())
+            updatePartitions(partitioned_.back(), num_partitions);
+    }
+    
+    // Plans of the degradation levels, prebuilt under a CPU budget so that the governor switches them
+    // without allocation (shorter kernels are planned with the same heterodyne and partitioned bands)
+    if (cpu_budget.get() > 0. || degradation_plan(degradation_) != NOMINAL) {
+        swapPlan(plans_[NOMINAL]);
+        for (std::size_t level=SKIP_FRAMES; level<=SHORTER_KERNELS; level++) {
+            if (degradation_plan(level) != level)
+                continue;
+            planKernels(Degradation(level), &plans_[NOMINAL]);
+            for (std::size_t i=0; i<heterodyne_.size(); i++) {
+                if (heterodyne_[i].decimation > 0) {
+                    bands_[i].algorithm = BandDescriptor::HETERODYNE;
+                    bands_[i].cost = plans_[NOMINAL].bands[i].cost;
+                }
+            }
+            count_gathered_bands();
+            for (auto const& stage : stages_)
+                max_rank = std::max(max_rank, stage.rank);
+            swapPlan(plans_[level]);
+        }
+        swapPlan(plans_[degradation_plan(degradation_)]);
+    }
+    stage_projections_.assign(max_rank * block_frames, 0.);
+}
+
+void wavelet::Filterbank::planKernels(Degradation level, KernelPlan const* nominal_plan)
+{
+    const std::size_t alignment = 64 / sizeof(double);
+    double tolerance = (accuracy.get() < 0.) ? std::pow(10., accuracy.get() / 20.) : 0.;
+    // Degraded quality (CPU budget): the kernels are truncated at least at the accuracy of the level
+    if (degradation_accuracies[level] < 0.)
+        tolerance = std::max(tolerance, std::pow(10., double(degradation_accuracies[level]) / 20.));
+    bands_.resize(wavelets_.size());
+    std::vector<std::size_t> truncated_taps(wavelets_.size(), 0);
+    std::vector<std::size_t> kernel_sources(wavelets_.size());
+    std::map<std::size_t, std::vector<std::size_t> > kernels_by_size;
+    std::size_t arena_size(0);
+    for (std::size_t i=0; i<wavelets_.size(); i++) {
+        std::vector< std::complex<double> > const& values = wavelets_[i]->values;
+        std::size_t full_size = values.size();
+        
+        // Bands sharing a kernel (across octaves) share its packed copy in the arena
+        kernel_sources[i] = i;
+        for (auto source : kernels_by_size[full_size]) {
+            if (wavelets_[source]->values == values) {
+                kernel_sources[i] = source;
+                break;
+            }
+        }
+        if (kernel_sources[i] != i) {
+            BandDescriptor const& source_band = bands_[kernel_sources[i]];
+            truncated_taps[i] = truncated_taps[kernel_sources[i]];
+            bands_[i].offset = source_band.offset;
+            bands_[i].window_size = source_band.window_size;
+            bands_[i].symmetry = source_band.symmetry;
+            bands_[i].half_size = source_band.half_size;
+            continue;
+        }
+        kernels_by_size[full_size].push_back(i);
+        
+        // Truncation: drop pairs of taps at both ends while their cumulated magnitude fits in the error budget
+        if (tolerance > 0.) {
+            double budget(0.);
+            for (auto &value : values)
+                budget += std::abs(value);
+            budget *= tolerance;
+            double dropped(0.);
+            while (2 * (truncated_taps[i] + 1) < full_size) {
+                double cost = std::abs(values[truncated_taps[i]]) + std::abs(values[full_size - 1 - truncated_taps[i]]);
+                if (dropped + cost > budget)
+                    break;
+                dropped += cost;
+                truncated_taps[i]++;
+            }
+        }
+        bands_[i].offset = arena_size;
+        bands_[i].window_size = full_size - 2 * truncated_taps[i];
+        // Symmetric kernels (centered on an odd window) only store half of the taps, if it saves multiplies
+        bands_[i].symmetry = Wavelet::ASYMMETRIC;
+        if (wavelets_[i]->mode.get() == Wavelet::RECURSIVE && bands_[i].window_size % 2 == 1 &&
+            2 * (bands_[i].window_size / 2 + 1) < 2 * bands_[i].window_size)
+            bands_[i].symmetry = wavelets_[i]->symmetry();
+        bands_[i].half_size = (bands_[i].symmetry == Wavelet::ASYMMETRIC) ? bands_[i].window_size : bands_[i].window_size / 2 + 1;
+        arena_size += 2 * bands_[i].half_size;
+        arena_size += (alignment - arena_size % alignment) % alignment;
+    }
+    kernel_arena_.assign(arena_size, 0.);
+    for (std::size_t i=0; i<wavelets_.size(); i++) {
+        BandDescriptor &band = bands_[i];
+        std::vector< std::complex<double> > const& values = wavelets_[i]->values;
+        int decimation = !decimated_stages(optimisation.get()) ? 1 : downsampling_factors[i];
+        // Bands sharing a kernel were packed with their source band
+        if (kernel_sources[i] == i) {
+            if (band.symmetry == Wavelet::ASYMMETRIC) {
+                double* kernel_real = kernel_arena_.data() + band.offset;
+                double* kernel_imag = kernel_real + band.window_size;
+                for (std::size_t k=0; k<band.window_size; k++) {
+                    kernel_real[k] = values[truncated_taps[i] + k].real();
+                    kernel_imag[k] = -values[truncated_taps[i] + k].imag();
+                }
+            } else {
+                // Even and odd parts of the conjugate kernel around its center
+                double* kernel_even = kernel_arena_.data() + band.offset;
+                double* kernel_odd = kernel_even + band.half_size;
+                std::size_t center = truncated_taps[i] + band.half_size - 1;
+                for (std::size_t k=0; k<band.half_size; k++) {
+                    std::complex<double> right = std::conj(values[center + k]);
+                    std::complex<double> left = std::conj(values[center - k]);
+                    if (band.symmetry == Wavelet::HERMITIAN) {
+                        kernel_even[k] = 0.5 * (right.real() + left.real());
+                        kernel_odd[k] = 0.5 * (right.imag() - left.imag());
+                    } else {
+                        kernel_even[k] = 0.5 * (right.imag() + left.imag());
+                        kernel_odd[k] = 0.5 * (right.real() - left.real());
+                    }
+                }
+                kernel_odd[0] = 0.;
+            }
+        }
+        band.algorithm = (band.symmetry == Wavelet::ASYMMETRIC) ? BandDescriptor::DIRECT : BandDescriptor::SYMMETRIC;
+        band.cost = 2. * double(band.half_size);
+        band.partitions = 0;
+        band.spectrum_offset = 0;
+        band.decimation = static_cast<std::size_t>(decimation);
+        std::size_t stride = (optimisation.get() == AGRESSIVE) ? 1 : band.decimation;
+        band.lag = stride * (values.size() - truncated_taps[i]);
+        band.prepad_value = wavelets_[i]->prepad_value_;
+        band.postpad_value = wavelets_[i]->postpad_value_;
+        for (std::size_t k=0; k<truncated_taps[i]; k++) {
+            band.prepad_value += std::conj(values[k]);
+            band.postpad_value += std::conj(values[values.size() - 1 - k]);
+        }
+        band.gain = std::sqrt(double(frontend_factor_ * decimation));
+        if (rescale.get())
+            band.gain /= std::sqrt(wavelets_[i]->scale.get());
+        // A trous cascade: compensate the attenuation of the B3-spline filters at the frequency of the band
+        if (optimisation.get() == ATROUS)
+            band.gain /= atrous_response(decimation, 2. * M_PI * frequencies[i] * double(frontend_factor_) / reference_wavelet_->samplerate.get());
+        band.buffer = &data_[decimation];
+        // Skipped frames: largest power-of-two multiple of the evaluation period keeping the band below a quarter of its rate
+        double samplerate_ratio = (reference_wavelet_->samplerate.get() / double(4 * frontend_factor_)) / frequencies[i];
+        band.hold = (optimisation.get() == AGRESSIVE) ? band.decimation : 1;
+        while (double(2 * band.hold) <= samplerate_ratio)
+            band.hold *= 2;
+    }
+    
+    // Stages: consecutive bands sharing a decimation factor read the same samples
+    stages_.clear();
+    for (std::size_t i=0; i<bands_.size(); i++) {
+        if (stages_.empty() || stages_.back().decimation != bands_[i].decimation) {
+            StageDescriptor stage;
+            stage.first_band = i;
+            stage.num_bands = 0;
+            stage.length = 0;
+            stage.decimation = bands_[i].decimation;
+            stage.buffer = bands_[i].buffer;
+            stage.stride = (optimisation.get() == AGRESSIVE) ? 1 : bands_[i].decimation;
+            stage.latest = (data_latest_.count(static_cast<int>(stage.decimation)) > 0) ? &data_latest_[static_cast<int>(stage.decimation)] : nullptr;
+            stage.rank = 0;
+            stage.basis_offset = 0;
+            stage.gathered_bands = stage.num_bands;
+            stage.block_size = 0;
+            stages_.push_back(stage);
+        }
+        stages_.back().num_bands++;
+        stages_.back().length = std::max(stages_.back().length, bands_[i].lag / stages_.back().stride);
+    }
+    double lowrank_tolerance = (lowrank_accuracy.get() < 0.) ? std::pow(10., lowrank_accuracy.get() / 20.) : 0.;
+    stage_direct_cost_.assign(stages_.size(), 0);
+    for (std::size_t stage_index=0; stage_index<stages_.size(); stage_index++) {
+        StageDescriptor &stage = stages_[stage_index];
+        for (std::size_t i=stage.first_band; i<stage.first_band+stage.num_bands; i++) {
+            bands_[i].first_sample = stage.length - bands_[i].lag / stage.stride;
+            stage_direct_cost_[stage_index] += 2 * bands_[i].half_size;
+        }
+        double stage_cost = double(stage_direct_cost_[stage_index]);
+        
+        // FFT-partitioned bands (stages at the input rate): block size minimizing the cost of the stage within the
+        // latency limit. Per sample, the forward FFT of two blocks is shared by the stage, and each band multiplies
+        // its partition spectra and computes an inverse FFT (a radix-2 FFT of size n costs 2 n log2(n) multiplies).
+        // Degraded levels keep the partitioned bands and the block size of the nominal plan, hence its latency.
+        if (nominal_plan != nullptr) {
+            stage.block_size = nominal_plan->stages[stage_index].block_size;
+        } else if (stage.decimation == 1 && stage.stride == 1) {
+            for (std::size_t block_size=2; (block_size - 1) * static_cast<std::size_t>(frontend_factor_) <= max_latency.get() && block_size / 2 < stage.length; block_size*=2) {
+                double fft_cost = 4. * std::log2(double(2 * block_size));
+                double cost(0.);
+                bool partitioned(false);
+                for (std::size_t i=stage.first_band; i<stage.first_band+stage.num_bands; i++) {
+                    double partitioned_cost = 8. * double((bands_[i].lag - 1) / block_size + 1) + fft_cost;
+                    partitioned = partitioned || (partitioned_cost < bands_[i].cost);
+                    cost += std::min(partitioned_cost, bands_[i].cost);
+                }
+                if (partitioned)
+                    cost += fft_cost;
+                if (cost < stage_cost) {
+                    stage_cost = cost;
+                    stage.block_size = block_size;
+                }
+            }
+        }
+        
+        // Low-rank approximation: eigendecomposition of the Gram matrix of the (real) kernel rows
+        if (lowrank_tolerance > 0. && (nominal_plan == nullptr || stage.block_size == 0)) {
+            std::size_t num_rows = 2 * stage.num_bands;
+            std::vector< std::vector<double> > rows(num_rows);
+            for (std::size_t b=0; b<stage.num_bands; b++) {
+                BandDescriptor const& band = bands_[stage.first_band + b];
+                std::vector< std::complex<double> > const& values = wavelets_[stage.first_band + b]->values;
+                std::size_t first_tap = (values.size() - band.window_size) / 2;
+                rows[2 * b].resize(band.window_size);
+                rows[2 * b + 1].resize(band.window_size);
+                for (std::size_t k=0; k<band.window_size; k++) {
+                    rows[2 * b][k] = values[first_tap + k].real();
+                    rows[2 * b + 1][k] = -values[first_tap + k].imag();
+                }
+            }
+            std::vector<double> gram(num_rows * num_rows);
+            for (std::size_t p=0; p<num_rows; p++) {
+                BandDescriptor const& band_p = bands_[stage.first_band + p / 2];
+                for (std::size_t q=p; q<num_rows; q++) {
+                    BandDescriptor const& band_q = bands_[stage.first_band + q / 2];
+                    std::size_t begin = std::max(band_p.first_sample, band_q.first_sample);
+                    std::size_t end = std::min(band_p.first_sample + band_p.window_size, band_q.first_sample + band_q.window_size);
+                    double product(0.);
+                    for (std::size_t n=begin; n<end; n++)
+                        product += rows[p][n - band_p.first_sample] * rows[q][n - band_q.first_sample];
+                    gram[p * num_rows + q] = product;
+                    gram[q * num_rows + p] = product;
+                }
+            }
+            std::vector<double> eigenvectors;
+            symmetric_eigen(gram, num_rows, eigenvectors);
+            std::vector<std::size_t> order(num_rows);
+            double energy(0.);
+            for (std::size_t p=0; p<num_rows; p++) {
+                order[p] = p;
+                energy += std::max(gram[p * num_rows + p], 0.);
+            }
+            std::sort(order.begin(), order.end(), [&gram, num_rows](std::size_t p, std::size_t q) {
+                return gram[p * num_rows + p] > gram[q * num_rows + q];
+            });
+            // Smallest rank whose residual energy fits in the error budget
+            std::size_t rank(num_rows);
+            double residual(0.);
+            while (rank > 0) {
+                double eigenvalue = std::max(gram[order[rank - 1] * num_rows + order[rank - 1]], 0.);
+                if (residual + eigenvalue > lowrank_tolerance * lowrank_tolerance * energy)
+                    break;
+                residual += eigenvalue;
+                rank--;
+            }
+            if (rank > 0 && double(rank * (stage.length + num_rows)) < stage_cost) {
+                // Basis filters: projections of the kernel rows on the dominant eigenvectors
+                stage.rank = rank;
+                stage.basis_offset = kernel_arena_.size();
+                std::size_t basis_size = rank * (stage.length + num_rows);
+                kernel_arena_.resize(stage.basis_offset + basis_size + (alignment - basis_size % alignment) % alignment, 0.);
+                double* basis = kernel_arena_.data() + stage.basis_offset;
+                double* coefficients = basis + rank * stage.length;
+                for (std::size_t r=0; r<rank; r++) {
+                    for (std::size_t p=0; p<num_rows; p++) {
+                        double coefficient = eigenvectors[p * num_rows + order[r]];
+                        BandDescriptor const& band = bands_[stage.first_band + p / 2];
+                        for (std::size_t k=0; k<band.window_size; k++)
+                            basis[r * stage.length + band.first_sample + k] += coefficient * rows[p][k];
+                        coefficients[p * rank + r] = coefficient;
+                    }
+                }
+                for (std::size_t i=stage.first_band; i<stage.first_band+stage.num_bands; i++) {
+                    bands_[i].algorithm = BandDescriptor::LOWRANK;
+                    bands_[i].cost = double(basis_size) / double(stage.num_bands);
+                }
+                stage.block_size = 0;
+                continue;
+            }
+        }
+#ifdef USE_ARMA
+        // Dispatch the stage to BLAS if the dense matrix-vector product is cheaper
+        double dense_cost = 2. * double(stage.num_bands * stage.length) / dense_speedup;
+        if (dense_cost < stage_cost && (nominal_plan == nullptr || stage.block_size == 0)) {
+            stage.kernels.zeros(2 * stage.num_bands, stage.length);
+            for (std::size_t b=0; b<stage.num_bands; b++) {
+                BandDescriptor const& band = bands_[stage.first_band + b];
+                std::vector< std::complex<double> > const& values = wavelets_[stage.first_band + b]->values;
+                std::size_t first_tap = (values.size() - band.window_size) / 2;
+                for (std::size_t k=0; k<band.window_size; k++) {
+                    stage.kernels(2 * b, band.first_sample + k) = values[first_tap + k].real();
+                    stage.kernels(2 * b + 1, band.first_sample + k) = -values[first_tap + k].imag();
+                }
+                bands_[stage.first_band + b].algorithm = BandDescriptor::DENSE;
+                bands_[stage.first_band + b].cost = dense_cost / double(stage.num_bands);
+            }
+            stage.block_size = 0;
+            continue;
+        }
+#endif
+        if (stage.block_size == 0)
+            continue;
+        
+        // Partition spectra of the kernels in lag order (lag 0 is the latest sample), including the post-padding,
+        // the gain and the normalization of the inverse FFT. The forward FFT is shared by the partitioned bands.
+        std::size_t block_size = stage.block_size;
+        std::size_t fft_size = 2 * block_size;
+        double fft_cost = 4. * std::log2(double(fft_size));
+        std::vector< std::complex<double> > twiddles = fft_twiddles(fft_size);
+        std::vector< std::complex<double> > spectrum(fft_size);
+        std::size_t num_partitioned(0);
+        for (std::size_t i=stage.first_band; i<stage.first_band+stage.num_bands; i++) {
+            BandDescriptor &band = bands_[i];
+            std::size_t partitions = (band.lag - 1) / block_size + 1;
+            double partitioned_cost = 8. * double(partitions) + fft_cost;
+            bool partitioned = (nominal_plan != nullptr) ? (nominal_plan->bands[i].algorithm == BandDescriptor::PARTITIONED) : (partitioned_cost < band.cost);
+            if (!partitioned)
+                continue;
+            std::vector< std::complex<double> > const& values = wavelets_[i]->values;
+            std::size_t first_tap = (values.size() - band.window_size) / 2;
+            double scale = band.gain / double(fft_size);
+            band.algorithm = BandDescriptor::PARTITIONED;
+            band.cost = partitioned_cost;
+            band.partitions = partitions;
+            band.spectrum_offset = kernel_arena_.size();
+            kernel_arena_.resize(band.spectrum_offset + 2 * partitions * fft_size, 0.);
+            for (std::size_t p=0; p<partitions; p++) {
+                std::fill(spectrum.begin(), spectrum.end(), std::complex<double>(0., 0.));
+                for (std::size_t lag=p*block_size; lag<std::min((p + 1) * block_size, band.lag); lag++) {
+                    if (lag + band.window_size >= band.lag)
+                        spectrum[lag - p * block_size] = scale * std::conj(values[first_tap + band.lag - 1 - lag]);
+                }
+                if (p == 0)
+                    spectrum[0] += scale * band.postpad_value;
+                fft_radix2(spectrum, twiddles);
+                for (std::size_t f=0; f<fft_size; f++) {
+                    kernel_arena_[band.spectrum_offset + 2 * (p * fft_size + f)] = spectrum[f].real();
+                    kernel_arena_[band.spectrum_offset + 2 * (p * fft_size + f) + 1] = spectrum[f].imag();
+                }
+            }
+            num_partitioned++;
+        }
+        for (std::size_t i=stage.first_band; i<stage.first_band+stage.num_bands; i++) {
+            if (bands_[i].algorithm == BandDescriptor::PARTITIONED)
+                bands_[i].cost += fft_cost / double(num_partitioned);
+        }
+    }
+}
+
+void wavelet::Filterbank::initHeterodyne()
+{
+    heterodyne_.resize(wavelets_.size());
+    for (std::size_t i=0; i<wavelets_.size(); i++) {
+        HeterodyneChannel &channel = heterodyne_[i];
+        channel.decimation = 0;
+        std::vector< std::complex<double> > const& values = wavelets_[i]->values;
+        std::size_t window_size = values.size();
+        if (window_size < 2)
+            continue;
+        
+        // Carrier of the conjugate kernel: phase of its lag-1 autocorrelation
+        std::complex<double> correlation(0., 0.);
+        for (std::size_t k=0; k+1<window_size; k++)
+            correlation += std::conj(values[k + 1]) * values[k];
+        double carrier = std::arg(correlation);
+        
+        // Bandwidth of the envelope: smallest band around DC holding all but -30 dB of its energy
+        // (the truncation of the window spreads a small part of the energy over all frequencies)
+        std::size_t fft_size(1);
+        while (fft_size < 2 * window_size)
+            fft_size <<= 1;
+        std::vector< std::complex<double> > spectrum(fft_size, std::complex<double>(0., 0.));
+        for (std::size_t k=0; k<window_size; k++)
+            spectrum[k] = std::conj(values[k]) * std::polar(1., -carrier * double(k));
+        fft_radix2(spectrum, fft_twiddles(fft_size));
+        std::vector<double> energies(fft_size / 2 + 1, 0.);
+        double total(0.);
+        for (std::size_t f=0; f<fft_size; f++) {
+            energies[std::min(f, fft_size - f)] += std::norm(spectrum[f]);
+            total += std::norm(spectrum[f]);
+        }
+        std::size_t half_bandwidth(0);
+        for (double energy(energies[0]); energy < (1. - 1e-3) * total && half_bandwidth < fft_size / 2; )
+            energy += energies[++half_bandwidth];
+        double bandwidth = double(half_bandwidth + 1) / double(fft_size);
+        std::size_t decimation = static_cast<std::size_t>(quantizeDownsamplingFactor(0.25 / bandwidth));
+        decimation = std::min(decimation, window_size);
+        
+        // Cost: mixing, low-pass filters, phasor, modulation and baseband kernel
+        LowpassFilter filter(0.8 / double(decimation));
+        std::size_t num_taps = (window_size - 1) / decimation + 1;
+        double cost = 2. + 2. * double(filter.a.size() + filter.b.size() - 1) + 8. + 4. * double(num_taps) / double(decimation);
+        if (decimation < 2 || cost >= bands_[i].cost)
+            continue;
+        channel.decimation = decimation;
+        channel.rotation = std::polar(1., carrier);
+        channel.phasor = std::conj(channel.rotation);
+        channel.modulation = std::polar(1., carrier * double(window_size - 1));
+        channel.filter_real = filter;
+        channel.filter_imag = filter;
+        channel.baseband.set_capacity(num_taps);
+        channel.baseband.resize(num_taps, std::complex<double>(0., 0.));
+        channel.envelope.resize(num_taps);
+        for (std::size_t j=0; j<num_taps; j++) {
+            std::size_t k = window_size - 1 - (num_taps - 1 - j) * decimation;
+            channel.envelope[j] = double(decimation) * std::conj(values[k]) * std::polar(1., -carrier * double(k));
+        }
+        channel.result = std::complex<double>(0., 0.);
+        channel.index = 0;
+        bands_[i].algorithm = BandDescriptor::HETERODYNE;
+        bands_[i].cost = cost;
+    }
+}
+
+void wavelet::Filterbank::resizeKeepingHistory(boost::circular_buffer<float>& buffer, std::size_t capacity)
+{
+    if (buffer.empty()) {
+        buffer.set_capacity(capacity);
+        return;
+    }
+    float oldest_value = buffer.front();
+    bool full = buffer.full();
+    buffer.rset_capacity(capacity);
+    if (full)
+        buffer.rresize(capacity, oldest_value);
 }
 
 void wavelet::Filterbank::reset()
@@ -298,10 +2094,57 @@ void wavelet::Filterbank::reset()
     for (auto data_it = data_.begin() ; data_it != data_.end() ; data_it++) {
         data_it->second.clear();
     }
+    for (auto &channel : heterodyne_) {
+        std::fill(channel.filter_real.z.begin(), channel.filter_real.z.end(), 0.);
+        std::fill(channel.filter_imag.z.begin(), channel.filter_imag.z.end(), 0.);
+        std::fill(channel.baseband.begin(), channel.baseband.end(), std::complex<double>(0., 0.));
+        channel.result = std::complex<double>(0., 0.);
+        channel.index = 0;
+    }
+    for (auto &convolution : partitioned_) {
+        convolution.history.clear();
+        convolution.count = 0;
+    }
     frame_index_ = 0;
+    frontend_index_ = 0;
+    spectral_buffer_.clear();
+    spectral_count_ = 0;
 }
 
 void wavelet::Filterbank::update(float value)
+{
+    if (cpu_budget.get() > 0. && !cpu_timing_) {
+        cpu_timing_ = true;
+        auto start = std::chrono::steady_clock::now();
+        updateFrame(value);
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        cpu_timing_ = false;
+        governCpuLoad(elapsed.count(), 1);
+        return;
+    }
+    updateFrame(value);
+}
+
+void wavelet::Filterbank::updateFrame(float value)
+{
+    if (wavelets_.empty())
+        return;
+    
+    // Front-end decimation: one (low-pass filtered) sample every front-end factor reaches the stages
+    if (frontend_factor_ > 1) {
+        if (data_.begin()->second.empty()) {
+            for (std::size_t i=0; i<2*frontend_factor_*data_.begin()->second.capacity()-1; ++i)
+                frontend_filter_.filter(value);
+        }
+        double filtered_value = frontend_filter_.filter(value);
+        if ((frontend_index_++ % frontend_factor_) != 0)
+            return;
+        value = float(filtered_value);
+    }
+    updateStages(value);
+}
+
+void wavelet::Filterbank::updateStages(float value)
 {
     // Update Buffers
     auto data_it = data_.begin();
@@ -315,63 +2158,685 @@ void wavelet::Filterbank::update(float value)
         }
         data_it++;
     }
-    if (optimisation.get() != NONE) {
+    if (optimisation.get() == ATROUS) {
+        // A trous cascade: each level is the previous one filtered by the B3-spline kernel dilated by its factor
+        for (auto previous_it = data_.begin(); data_it != data_.end(); previous_it++, data_it++) {
+            boost::circular_buffer<float> const& previous = previous_it->second;
+            std::size_t hole = previous_it->first;
+            std::size_t center = previous.size() - 1 - 2 * hole;
+            float lowpass_value = atrous_kernel[0] * previous[center]
+                                  + atrous_kernel[1] * (previous[center - hole] + previous[center + hole])
+                                  + atrous_kernel[2] * (previous[center - 2 * hole] + previous[center + 2 * hole]);
+            if (data_it->second.size() > 0) {
+                data_it->second.push_back(lowpass_value);
+            } else {
+                for (unsigned int i=0; i<2*data_it->second.capacity()-1; ++i) {
+                    data_it->second.push_back(lowpass_value);
+                }
+            }
+        }
+    } else if (decimated_stages(optimisation.get())) {
         double filtered_value(value);
+        // Buffers stored at the decimated rate only receive the samples read by the kernels
+        bool decimated_rate = (optimisation.get() == AGRESSIVE);
+        auto latest_it = data_latest_.begin();
         for (auto filters_it = filters_.begin(); filters_it != filters_.end(); filters_it++, data_it++) {
             filtered_value = filters_it->second.filter(value);
             if (data_it->second.size() > 0) {
-                data_it->second.push_back(filtered_value);
+                if (!decimated_rate || (frame_index_ % data_it->first) == 1)
+                    data_it->second.push_back(filtered_value);
             } else {
-                for (unsigned int i=0; i<2*data_it->second.capacity()-1; ++i) {
+                std::size_t input_capacity = data_it->second.capacity() * (decimated_rate ? data_it->first : 1);
+                for (unsigned int i=0; i<2*input_capacity-1; ++i) {
                     filtered_value = filters_it->second.filter(value);
                 }
                 for (unsigned int i=0; i<2*data_it->second.capacity()-1; ++i) {
                     data_it->second.push_back(filtered_value);
                 }
             }
+            if (decimated_rate)
+                (latest_it++)->second = float(filtered_value);
         }
     }
     
-    // Update filter
-    data_it = data_.begin();
-    int previous_downrate(1);
-    for (std::size_t filter_index=0 ; filter_index<wavelets_.size() ; filter_index++) {
-        if (optimisation.get() != NONE) {
-            if (downsampling_factors[filter_index] != previous_downrate) {
-                if (filter_index > 0)
-                    data_it++;
-                previous_downrate = downsampling_factors[filter_index];
+    // Heterodyne channels: mix down, low-pass filter, and convolve one sample every decimation
+    for (auto &channel : heterodyne_) {
+        if (channel.decimation == 0)
+            continue;
+        channel.phasor *= channel.rotation;
+        double mixed_real = channel.filter_real.filter(double(value) * channel.phasor.real());
+        double mixed_imag = channel.filter_imag.filter(double(value) * channel.phasor.imag());
+        if ((channel.index++ % channel.decimation) != 0)
+            continue;
+        channel.phasor /= std::abs(channel.phasor);
+        channel.baseband.push_back(std::complex<double>(mixed_real, mixed_imag));
+        std::complex<double> result(0., 0.);
+        for (std::size_t j=0; j<channel.envelope.size(); j++)
+            result += channel.baseband[j] * channel.envelope[j];
+        channel.result = result;
+    }
+    
+    // Partitioned convolutions: one FFT block every block size samples, whose outputs are emitted during the next block
+    for (auto &convolution : partitioned_) {
+        if (convolution.history.size() > 0) {
+            convolution.history.push_back(value);
+            if (++convolution.count == convolution.block_size) {
+                convolution.count = 0;
+                updatePartitions(convolution, 1);
             }
+        } else {
+            convolution.history.resize(convolution.history.capacity(), value);
+            convolution.count = 0;
+            updatePartitions(convolution, convolution.num_partitions);
         }
-        
+        StageDescriptor const& stage = stages_[convolution.stage];
+        // Pre-padding: oldest sample of the data buffer at the time of the delayed output
+        double prepad_sample = double(convolution.history[convolution.history.size() - convolution.block_size - stage.buffer->capacity() + 1]);
+        for (std::size_t band_index=stage.first_band; band_index<stage.first_band+stage.num_bands; band_index++) {
+            BandDescriptor const& band = bands_[band_index];
+            if (band.algorithm != BandDescriptor::PARTITIONED)
+                continue;
+            result_complex[band_index] = convolution.outputs[(band_index - stage.first_band) * convolution.block_size + convolution.count]
+                                         + prepad_sample * band.prepad_value * band.gain;
+            result_power[band_index] = std::norm(result_complex[band_index]);
+        }
+    }
+    
+    // Update filter: the samples of each stage are gathered once, then shared by its bands
+    for (auto const& stage : stages_) {
         if (optimisation.get() == AGRESSIVE) {
-            if ((frame_index_ % downsampling_factors[filter_index]) != 0) {
+            if ((frame_index_ % stage.decimation) != 0) {
                 continue;
             }
         }
-        result_complex[filter_index] = std::complex<double>(0., 0.);
-        
-        // Padding: before
-        result_complex[filter_index] = std::complex<double>(data_it->second[0], 0) * wavelets_[filter_index]->prepad_value_;
-        // Data
-        std::size_t wvt_index(0);
-        std::size_t decim = static_cast<std::size_t>(data_it->first);
-        for (std::size_t data_index=data_it->second.size() - decim * wavelets_[filter_index]->window_size.get();
-             data_index<data_it->second.size();
-             data_index+=decim, wvt_index++) {
-            result_complex[filter_index] += std::complex<double>(data_it->second[data_index], 0) * std::conj(wavelets_[filter_index]->values[wvt_index]);
-        }
-        // Padding: after
-        result_complex[filter_index] += std::complex<double>(data_it->second[data_it->second.size()-1], 0) * wavelets_[filter_index]->postpad_value_;
-        // Rescale
-        if (rescale.get())
-            result_complex[filter_index] /= std::sqrt(wavelets_[filter_index]->scale.get());
-        result_complex[filter_index] *= std::sqrt(double(decim));
-        result_power[filter_index] = std::norm(result_complex[filter_index]);
+        // Skipped frames: the holding periods of the bands of a stage are multiples of the first one
+        if (degradation_ >= SKIP_FRAMES && (frame_index_ % bands_[stage.first_band].hold) != 0)
+            continue;
+        boost::circular_buffer<float> const& buffer = *stage.buffer;
+        double* samples = stage_samples_.data();
+        const double* basis = kernel_arena_.data() + stage.basis_offset;
+        const double* coefficients = basis + stage.rank * stage.length;
+        double* projections = stage_projections_.data();
+#ifdef USE_ARMA
+        arma::vec stage_result;
+#endif
+        if (stage.gathered_bands > 0) {
+            // Data: the circular buffer is stored in two contiguous segments
+            boost::circular_buffer<float>::const_array_range first_segment = buffer.array_one();
+            boost::circular_buffer<float>::const_array_range second_segment = buffer.array_two();
+            std::size_t data_index = buffer.size() - stage.length * stage.stride;
+            std::size_t sample_index(0);
+            for (; data_index < first_segment.second && sample_index < stage.length; data_index+=stage.stride, sample_index++) {
+                samples[sample_index] = double(first_segment.first[data_index]);
+            }
+            data_index -= first_segment.second;
+            for (; sample_index < stage.length; data_index+=stage.stride, sample_index++) {
+                samples[sample_index] = double(second_segment.first[data_index]);
+            }
+            
+            // Low-rank stage: convolution with the basis filters, projected to the bands
+            for (std::size_t r=0; r<stage.rank; r++) {
+                double projection(0.);
+                for (std::size_t n=0; n<stage.length; n++)
+                    projection += samples[n] * basis[r * stage.length + n];
+                projections[r] = projection;
+            }
+#ifdef USE_ARMA
+            if (!stage.kernels.is_empty())
+                stage_result = stage.kernels * arma::vec(samples, stage.length, false, true);
+#endif
+        }
+        double latest_value = (stage.latest != nullptr) ? double(*stage.latest) : double(buffer.back());
+        for (std::size_t band_index=stage.first_band; band_index<stage.first_band+stage.num_bands; band_index++) {
+            BandDescriptor const& band = bands_[band_index];
+            if (band.algorithm == BandDescriptor::PARTITIONED || (degradation_ >= SKIP_FRAMES && (frame_index_ % band.hold) != 0))
+                continue;
+            const double* band_samples = samples + band.first_sample;
+            double sum_real(0.);
+            double sum_imag(0.);
+            if (band.algorithm == BandDescriptor::LOWRANK) {
+                const double* coefficients_real = coefficients + 2 * (band_index - stage.first_band) * stage.rank;
+                const double* coefficients_imag = coefficients_real + stage.rank;
+                for (std::size_t r=0; r<stage.rank; r++) {
+                    sum_real += coefficients_real[r] * projections[r];
+                    sum_imag += coefficients_imag[r] * projections[r];
+                }
+            } else
+            if (band.algorithm == BandDescriptor::HETERODYNE) {
+                HeterodyneChannel const& channel = heterodyne_[band_index];
+                std::complex<double> sum = std::conj(channel.phasor) * channel.modulation * channel.result;
+                sum_real = sum.real();
+                sum_imag = sum.imag();
+            } else
+#ifdef USE_ARMA
+            if (band.algorithm == BandDescriptor::DENSE) {
+                sum_real = stage_result(2 * (band_index - stage.first_band));
+                sum_imag = stage_result(2 * (band_index - stage.first_band) + 1);
+            } else
+#endif
+            if (band.algorithm == BandDescriptor::DIRECT) {
+                const double* kernel_real = kernel_arena_.data() + band.offset;
+                const double* kernel_imag = kernel_real + band.window_size;
+                for (std::size_t k=0; k<band.window_size; k++) {
+                    sum_real += band_samples[k] * kernel_real[k];
+                    sum_imag += band_samples[k] * kernel_imag[k];
+                }
+            } else {
+                // Symmetric kernel: pre-add and pre-subtract mirrored samples around the center
+                const double* kernel_even = kernel_arena_.data() + band.offset;
+                const double* kernel_odd = kernel_even + band.half_size;
+                const double* center = band_samples + band.half_size - 1;
+                double sum_even = center[0] * kernel_even[0];
+                double sum_odd(0.);
+                for (std::size_t k=1; k<band.half_size; k++) {
+                    sum_even += (center[k] + *(center - k)) * kernel_even[k];
+                    sum_odd += (center[k] - *(center - k)) * kernel_odd[k];
+                }
+                sum_real = (band.symmetry == Wavelet::HERMITIAN) ? sum_even : sum_odd;
+                sum_imag = (band.symmetry == Wavelet::HERMITIAN) ? sum_odd : sum_even;
+            }
+            
+            // Padding: before and after
+            result_complex[band_index] = double(buffer.front()) * band.prepad_value
+                                         + std::complex<double>(sum_real, sum_imag)
+                                         + latest_value * band.postpad_value;
+            result_complex[band_index] *= band.gain;
+            result_power[band_index] = std::norm(result_complex[band_index]);
+        }
     }
     frame_index_++;
 }
 
+void wavelet::Filterbank::update(std::vector<float> const& values, std::vector< std::complex<double> >& scalogram)
+{
+    if (cpu_budget.get() > 0. && !cpu_timing_) {
+        cpu_timing_ = true;
+        auto start = std::chrono::steady_clock::now();
+        update(values, scalogram);
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        cpu_timing_ = false;
+        governCpuLoad(elapsed.count(), values.size());
+        return;
+    }
+    if (frontend_factor_ <= 1) {
+        updateBlock(values, scalogram);
+        return;
+    }
+    scalogram.assign(values.size() * size(), std::complex<double>(0., 0.));
+    if (wavelets_.empty())
+        return;
+    
+    // Empty buffers are filled by the first sample
+    std::size_t first_value(0);
+    for (; first_value < values.size() && data_.begin()->second.empty(); first_value++) {
+        update(values[first_value]);
+        std::copy(result_complex.begin(), result_complex.end(), scalogram.begin() + first_value * size());
+    }
+    
+    // Front-end decimation: the stages process the decimated block, and the results are held in between
+    std::vector<float> decimated_values;
+    std::vector<std::size_t> decimated_frames;
+    for (std::size_t t=first_value; t<values.size(); t++) {
+        double filtered_value = frontend_filter_.filter(values[t]);
+        if ((frontend_index_++ % frontend_factor_) == 0) {
+            decimated_values.push_back(float(filtered_value));
+            decimated_frames.push_back(t);
+        }
+    }
+    std::vector< std::complex<double> > held_results(result_complex);
+    std::vector< std::complex<double> > decimated_scalogram;
+    updateBlock(decimated_values, decimated_scalogram);
+    std::size_t decimated_index(0);
+    for (std::size_t t=first_value; t<values.size(); t++) {
+        if (decimated_index < decimated_frames.size() && decimated_frames[decimated_index] == t) {
+            std::copy(decimated_scalogram.begin() + decimated_index * size(),
+                      decimated_scalogram.begin() + (decimated_index + 1) * size(),
+                      held_results.begin());
+            decimated_index++;
+        }
+        std::copy(held_results.begin(), held_results.end(), scalogram.begin() + t * size());
+    }
+}
+
+void wavelet::Filterbank::governCpuLoad(double elapsed, std::size_t num_samples)
+{
+    if (num_samples == 0)
+        return;
+    double weight = std::min(1., double(num_samples) / cpu_window);
+    cpu_load_ += weight * (elapsed / double(num_samples) - cpu_load_);
+    cpu_samples_ += num_samples;
+    if (cpu_samples_ < cpu_settling)
+        return;
+    // Speedup of the current level, measured once the average has settled after the level was raised
+    if (degradation_ > NOMINAL && degradation_speedups_[degradation_] == 0.)
+        degradation_speedups_[degradation_] = std::max(1., degradation_entry_load_ / cpu_load_);
+    if (cpu_load_ > cpu_budget.get() && degradation_ < SHORTER_KERNELS) {
+        degradation_entry_load_ = cpu_load_;
+        setDegradation(Degradation(degradation_ + 1));
+    } else if (degradation_ > NOMINAL && cpu_load_ * degradation_speedups_[degradation_] < cpu_recovery * cpu_budget.get()) {
+        setDegradation(Degradation(degradation_ - 1));
+    }
+}
+
+void wavelet::Filterbank::setDegradation(Degradation level)
+{
+    std::size_t current_plan = degradation_plan(degradation_);
+    std::size_t plan = degradation_plan(level);
+    degradation_ = level;
+    cpu_samples_ = 0;
+    if (plan == current_plan || wavelets_.empty())
+        return;
+    // The plans are prebuilt under a CPU budget, otherwise they are built on request
+    if (plans_.size() <= plan || plans_[plan].bands.empty()) {
+        packKernels();
+        return;
+    }
+    swapPlan(plans_[current_plan]);
+    swapPlan(plans_[plan]);
+}
+
+void wavelet::Filterbank::swapPlan(KernelPlan& plan)
+{
+    bands_.swap(plan.bands);
+    stages_.swap(plan.stages);
+    stage_direct_cost_.swap(plan.stage_direct_cost);
+    kernel_arena_.swap(plan.kernel_arena);
+}
+
+void wavelet::Filterbank::updateBlock(std::vector<float> const& values, std::vector< std::complex<double> >& scalogram)
+{
+    scalogram.assign(values.size() * size(), std::complex<double>(0., 0.));
+    if (wavelets_.empty())
+        return;
+    
+    // Heterodyne channels, partitioned convolutions, the a trous cascade and skipped frames are updated sample by sample
+    if (!heterodyne_.empty() || !partitioned_.empty() || optimisation.get() == ATROUS || degradation_ >= SKIP_FRAMES) {
+        for (std::size_t t=0; t<values.size(); t++) {
+            updateStages(values[t]);
+            std::copy(result_complex.begin(), result_complex.end(), scalogram.begin() + t * size());
+        }
+        return;
+    }
+    
+    // Empty buffers are filled by the first sample
+    std::size_t first_value(0);
+    for (; first_value < values.size(); first_value++) {
+        bool empty_buffers(false);
+        for (auto &data : data_)
+            empty_buffers = empty_buffers || data.second.empty();
+        if (!empty_buffers)
+            break;
+        updateStages(values[first_value]);
+        std::copy(result_complex.begin(), result_complex.end(), scalogram.begin() + first_value * size());
+    }
+    std::size_t num_frames = values.size() - first_value;
+    if (num_frames == 0)
+        return;
+    
+    // (Filtered) samples of the block at the input of each stage, and samples stored in its buffer
+    std::map<int, std::vector<float>> block_inputs;
+    std::map<int, std::vector<float>> block_samples;
+    for (auto &data : data_) {
+        std::vector<float> &inputs = block_inputs[data.first];
+        if (data.first == 1) {
+            inputs.assign(values.begin() + first_value, values.end());
+        } else {
+            LowpassFilter &filter = filters_[data.first];
+            inputs.reserve(num_frames);
+            for (std::size_t t=first_value; t<values.size(); t++)
+                inputs.push_back(filter.filter(values[t]));
+        }
+        if (data_latest_.count(data.first) > 0) {
+            std::vector<float> &samples = block_samples[data.first];
+            for (std::size_t t=0; t<num_frames; t++) {
+                if ((frame_index_ + t) % data.first == 1)
+                    samples.push_back(inputs[t]);
+            }
+        } else {
+            block_samples[data.first] = inputs;
+        }
+    }
+    
+    std::vector< std::complex<double> > block_scalogram(num_frames * size());
+    for (auto const& stage : stages_)
+        updateStageBlock(stage,
+                         block_inputs[static_cast<int>(stage.decimation)],
+                         block_samples[static_cast<int>(stage.decimation)],
+                         block_scalogram);
+    
+    // Skipped frames (agressive optimisation) hold the previous results
+    if (optimisation.get() == AGRESSIVE) {
+        for (auto const& stage : stages_) {
+            for (std::size_t t=0; t<num_frames; t++) {
+                if ((frame_index_ + t) % stage.decimation == 0)
+                    continue;
+                for (std::size_t band_index=stage.first_band; band_index<stage.first_band+stage.num_bands; band_index++) {
+                    block_scalogram[t * size() + band_index] = (t == 0) ? result_complex[band_index] : block_scalogram[(t - 1) * size() + band_index];
+                }
+            }
+        }
+    }
+    std::copy(block_scalogram.begin(), block_scalogram.end(), scalogram.begin() + first_value * size());
+    std::copy(block_scalogram.end() - size(), block_scalogram.end(), result_complex.begin());
+    for (std::size_t band_index=0; band_index<size(); band_index++)
+        result_power[band_index] = std::norm(result_complex[band_index]);
+    
+    // Update Buffers
+    for (auto &data : data_) {
+        std::vector<float> const& samples = block_samples[data.first];
+        std::size_t num_pushed = std::min(samples.size(), data.second.capacity());
+        for (auto samples_it = samples.end() - num_pushed; samples_it != samples.end(); samples_it++)
+            data.second.push_back(*samples_it);
+    }
+    for (auto &latest : data_latest_)
+        latest.second = block_inputs[latest.first].back();
+    frame_index_ += static_cast<int>(num_frames);
+}
+
+void wavelet::Filterbank::updateStageBlock(StageDescriptor const& stage,
+                                           std::vector<float> const& block_inputs,
+                                           std::vector<float> const& block_samples,
+                                           std::vector< std::complex<double> >& scalogram)
+{
+    // Stage history: contents of the buffer before the block, followed by the samples stored during the block.
+    // If the newest stored sample at frame t is history(e), frame t sees history(e+1-buffer_size) .. history(e)
+    boost::circular_buffer<float> const& buffer = *stage.buffer;
+    std::size_t buffer_size = buffer.size();
+    std::size_t num_frames = block_inputs.size();
+    auto history = [&](std::size_t index) {
+        return double((index < buffer_size) ? buffer[index] : block_samples[index - buffer_size]);
+    };
+    std::size_t step = stage.decimation;
+    std::size_t num_residues = (optimisation.get() == AGRESSIVE) ? 1 : step;
+    for (std::size_t residue=0; residue<num_residues; residue++) {
+        // Frames sharing a residue modulo the decimation see the same decimated sequence, shifted by one sample:
+        // their samples form a Hankel matrix, stored as the sequence itself
+        std::size_t first_frame = (residue + step - frame_index_ % step) % step;
+        if (first_frame >= num_frames)
+            continue;
+        std::size_t residue_frames = (num_frames - first_frame + step - 1) / step;
+        // Index of the newest stored sample at the first frame (the next frames of the residue add stride samples each)
+        std::size_t stored_samples = first_frame + 1;
+        if (stage.latest != nullptr) {
+            std::size_t first_stored = (1 + step - frame_index_ % step) % step;
+            stored_samples = (first_frame >= first_stored) ? (first_frame - first_stored) / step + 1 : 0;
+        }
+        std::size_t newest_index = buffer_size + stored_samples - 1;
+        std::size_t first_index = newest_index + 1 - stage.length * stage.stride;
+        std::size_t sequence_length = stage.length + residue_frames - 1;
+        if (stage_samples_.size() < sequence_length + block_frames)
+            stage_samples_.resize(sequence_length + block_frames);
+        for (std::size_t m=0; m<sequence_length; m++)
+            stage_samples_[m] = history(first_index + m * stage.stride);
+        std::fill(stage_samples_.begin() + sequence_length, stage_samples_.begin() + sequence_length + block_frames, 0.);
+        
+        for (std::size_t tile=0; tile<residue_frames; tile+=block_frames) {
+            std::size_t tile_frames = std::min(block_frames, residue_frames - tile);
+            // Low-rank stage: convolution with the basis filters, projected to the bands
+            const double* basis = kernel_arena_.data() + stage.basis_offset;
+            const double* coefficients = basis + stage.rank * stage.length;
+            double* projections = stage_projections_.data();
+            for (std::size_t r=0; r<stage.rank; r++) {
+                double* projection = projections + r * block_frames;
+                std::fill(projection, projection + block_frames, 0.);
+                for (std::size_t n=0; n<stage.length; n++) {
+                    const double* samples = stage_samples_.data() + tile + n;
+                    for (std::size_t j=0; j<block_frames; j++)
+                        projection[j] += samples[j] * basis[r * stage.length + n];
+                }
+            }
+            for (std::size_t band_index=stage.first_band; band_index<stage.first_band+stage.num_bands; band_index++) {
+                BandDescriptor const& band = bands_[band_index];
+                const double* band_samples = stage_samples_.data() + band.first_sample + tile;
+                double sum_real[block_frames] = {0.};
+                double sum_imag[block_frames] = {0.};
+                // Dense stages are evaluated with their packed kernels in the block update
+                if (band.algorithm == BandDescriptor::LOWRANK) {
+                    const double* coefficients_real = coefficients + 2 * (band_index - stage.first_band) * stage.rank;
+                    const double* coefficients_imag = coefficients_real + stage.rank;
+                    for (std::size_t r=0; r<stage.rank; r++) {
+                        for (std::size_t j=0; j<block_frames; j++) {
+                            sum_real[j] += coefficients_real[r] * projections[r * block_frames + j];
+                            sum_imag[j] += coefficients_imag[r] * projections[r * block_frames + j];
+                        }
+                    }
+                } else if (band.symmetry == Wavelet::ASYMMETRIC) {
+                    const double* kernel_real = kernel_arena_.data() + band.offset;
+                    const double* kernel_imag = kernel_real + band.window_size;
+                    for (std::size_t k=0; k<band.window_size; k++) {
+                        const double* samples = band_samples + k;
+                        for (std::size_t j=0; j<block_frames; j++) {
+                            sum_real[j] += samples[j] * kernel_real[k];
+                            sum_imag[j] += samples[j] * kernel_imag[k];
+                        }
+                    }
+                } else {
+                    // Symmetric kernel: pre-add and pre-subtract mirrored samples around the center
+                    const double* kernel_even = kernel_arena_.data() + band.offset;
+                    const double* kernel_odd = kernel_even + band.half_size;
+                    const double* center = band_samples + band.half_size - 1;
+                    double sum_even[block_frames];
+                    double sum_odd[block_frames] = {0.};
+                    for (std::size_t j=0; j<block_frames; j++)
+                        sum_even[j] = center[j] * kernel_even[0];
+                    for (std::size_t k=1; k<band.half_size; k++) {
+                        const double* right = center + k;
+                        const double* left = center - k;
+                        for (std::size_t j=0; j<block_frames; j++) {
+                            sum_even[j] += (right[j] + left[j]) * kernel_even[k];
+                            sum_odd[j] += (right[j] - left[j]) * kernel_odd[k];
+                        }
+                    }
+                    for (std::size_t j=0; j<block_frames; j++) {
+                        sum_real[j] = (band.symmetry == Wavelet::HERMITIAN) ? sum_even[j] : sum_odd[j];
+                        sum_imag[j] = (band.symmetry == Wavelet::HERMITIAN) ? sum_odd[j] : sum_even[j];
+                    }
+                }
+                
+                // Padding: before and after
+                for (std::size_t j=0; j<tile_frames; j++) {
+                    std::size_t t = first_frame + (tile + j) * step;
+                    std::complex<double> result = history(newest_index + (tile + j) * stage.stride + 1 - buffer_size) * band.prepad_value
+                                                  + std::complex<double>(sum_real[j], sum_imag[j])
+                                                  + double(block_inputs[t]) * band.postpad_value;
+                    scalogram[t * size() + band_index] = result * band.gain;
+                }
+            }
+        }
+    }
+}
+
+void wavelet::Filterbank::updatePartitions(PartitionedConvolution& convolution, std::size_t num_frames)
+{
+    StageDescriptor const& stage = stages_[convolution.stage];
+    std::size_t block_size = convolution.block_size;
+    std::size_t fft_size = 2 * block_size;
+    std::size_t num_partitions = convolution.num_partitions;
+    std::vector< std::complex<double> > &spectrum = convolution.spectrum;
+    
+    // Input spectra: frames of two blocks ending at the latest block, and at the previous ones if the convolution restarts
+    convolution.head = (convolution.head + num_partitions - num_frames % num_partitions) % num_partitions;
+    for (std::size_t frame=0; frame<num_frames; frame++) {
+        std::size_t frame_end = convolution.history.size() - convolution.count - frame * block_size;
+        for (std::size_t n=0; n<fft_size; n++)
+            spectrum[n] = std::complex<double>(double(convolution.history[frame_end - fft_size + n]), 0.);
+        fft_radix2(spectrum, convolution.twiddles);
+        std::copy(spectrum.begin(), spectrum.end(), convolution.spectra.begin() + ((convolution.head + frame) % num_partitions) * fft_size);
+    }
+    
+    // Outputs: conjugate products with the partition spectra of each band, accumulated over the delay line,
+    // and inverse FFT (conjugate of the FFT of the conjugate). The second half of the frame is valid (overlap-save).
+    double* accumulator = reinterpret_cast<double*>(spectrum.data());
+    for (std::size_t b=0; b<stage.num_bands; b++) {
+        BandDescriptor const& band = bands_[stage.first_band + b];
+        if (band.algorithm != BandDescriptor::PARTITIONED)
+            continue;
+        std::fill(spectrum.begin(), spectrum.end(), std::complex<double>(0., 0.));
+        for (std::size_t p=0; p<band.partitions; p++) {
+            const double* kernel = kernel_arena_.data() + band.spectrum_offset + 2 * p * fft_size;
+            const double* input = reinterpret_cast<const double*>(convolution.spectra.data() + ((convolution.head + p) % num_partitions) * fft_size);
+            for (std::size_t f=0; f<fft_size; f++) {
+                accumulator[2 * f] += kernel[2 * f] * input[2 * f] - kernel[2 * f + 1] * input[2 * f + 1];
+                accumulator[2 * f + 1] -= kernel[2 * f] * input[2 * f + 1] + kernel[2 * f + 1] * input[2 * f];
+            }
+        }
+        fft_radix2(spectrum, convolution.twiddles);
+        for (std::size_t n=0; n<block_size; n++)
+            convolution.outputs[b * block_size + n] = std::conj(spectrum[block_size + n]);
+    }
+}
+
+void wavelet::Filterbank::initSpectral(std::size_t hop_size, float accuracy)
+{
+    if (hop_size == 0)
+        throw std::domain_error("The hop size of the constant-Q engine must be positive");
+    if (!(accuracy <= 0.))
+        throw std::domain_error("The accuracy of the constant-Q engine must be negative or zero (dB)");
+    spectral_hop_ = hop_size;
+    spectral_accuracy_ = accuracy;
+    spectral_count_ = 0;
+    // Empty history: warm-filled with the first sample, as the buffers of update()
+    spectral_buffer_ = boost::circular_buffer<float>();
+    initSpectralKernels();
+}
+
+void wavelet::Filterbank::initSpectralKernels()
+{
+    // Kernels of the bands at the input sampling rate (as in the NONE optimisation mode)
+    double samplerate = reference_wavelet_->samplerate.get();
+    std::vector< std::shared_ptr<Wavelet> > kernels(wavelets_.size());
+    std::size_t max_window(1);
+    for (std::size_t i=0; i<wavelets_.size(); i++) {
+        bool full_rate = (frontend_factor_ == 1) && (downsampling_factors.empty() || downsampling_factors[i] == 1);
+        if (full_rate) {
+            kernels[i] = wavelets_[i];
+        } else {
+            switch (family.get()) {
+                case wavelet::MORLET:
+                    kernels[i] = std::shared_ptr<MorletWavelet>(new MorletWavelet(*std::static_pointer_cast<MorletWavelet>(reference_wavelet_)));
+                    break;
+                    
+                case wavelet::PAUL:
+                    kernels[i] = std::shared_ptr<PaulWavelet>(new PaulWavelet(*std::static_pointer_cast<PaulWavelet>(reference_wavelet_)));
+                    break;
+                    
+                default:
+                    throw std::runtime_error("Wavelet not implemented");
+                    break;
+            }
+            kernels[i]->samplerate.set(samplerate, true);
+            kernels[i]->scale.set(scales[i], true);
+            kernels[i]->setDefaultWindowsize(true);
+            kernels[i]->init();
+        }
+        max_window = std::max(max_window, kernels[i]->values.size());
+    }
+    std::size_t fft_size(1);
+    while (fft_size < max_window)
+        fft_size <<= 1;
+    spectral_twiddles_ = fft_twiddles(fft_size);
+    spectral_spectrum_.resize(fft_size);
+    resizeKeepingHistory(spectral_buffer_, fft_size);
+    
+    // Sparse kernels: the bins of smallest magnitude are dropped while their sum stays in the accuracy budget
+    double tolerance = (spectral_accuracy_ < 0.) ? std::pow(10., spectral_accuracy_ / 20.) : 0.;
+    spectral_offsets_.assign(1, 0);
+    spectral_bins_.clear();
+    spectral_kernels_.clear();
+    spectral_pads_.clear();
+    spectral_prepad_index_ = fft_size - max_window;
+    std::vector< std::complex<double> > spectrum(fft_size);
+    std::vector<double> magnitudes(fft_size);
+    std::vector<std::size_t> order(fft_size);
+    for (std::size_t i=0; i<kernels.size(); i++) {
+        // Conjugate of the kernel of update(), aligned on the end of the frame (latest sample). The padding
+        // terms are impulses (flat spectra): they are applied in the time domain to keep the kernels sparse
+        std::vector< std::complex<double> > const& values = kernels[i]->values;
+        spectrum.assign(fft_size, std::complex<double>(0., 0.));
+        for (std::size_t k=0; k<values.size(); k++)
+            spectrum[fft_size - values.size() + k] = values[k];
+        double gain = rescale.get() ? 1. / std::sqrt(scales[i]) : 1.;
+        spectral_pads_.push_back(kernels[i]->prepad_value_ * gain);
+        spectral_pads_.push_back(kernels[i]->postpad_value_ * gain);
+        
+        // Parseval: sum_n x[n] h[n] = 1/N sum_f X[f] conj(DFT(conj(h)))[f]
+        fft_radix2(spectrum, spectral_twiddles_);
+        gain /= double(fft_size);
+        double total(0.);
+        for (std::size_t f=0; f<fft_size; f++) {
+            magnitudes[f] = std::norm(spectrum[f]);
+            total += magnitudes[f];
+            order[f] = f;
+        }
+        std::sort(order.begin(), order.end(), [&magnitudes](std::size_t a, std::size_t b) {
+            return magnitudes[a] < magnitudes[b];
+        });
+        double dropped(0.);
+        for (auto f : order) {
+            if (dropped + magnitudes[f] > tolerance * tolerance * total)
+                break;
+            dropped += magnitudes[f];
+            magnitudes[f] = -1.;
+        }
+        for (std::size_t f=0; f<fft_size; f++) {
+            if (magnitudes[f] < 0.)
+                continue;
+            spectral_bins_.push_back(f);
+            spectral_kernels_.push_back(std::conj(spectrum[f]) * gain);
+        }
+        spectral_offsets_.push_back(spectral_bins_.size());
+    }
+    spectral_fingerprint_ = configurationFingerprint();
+}
+
+void wavelet::Filterbank::updateSpectral(std::vector<float> const& values, std::vector< std::complex<double> >& frames)
+{
+    if (spectral_hop_ == 0)
+        throw std::runtime_error("The constant-Q engine is not configured (see initSpectral)");
+    if (spectral_fingerprint_ != configurationFingerprint())
+        initSpectralKernels();
+    frames.clear();
+    std::size_t num_bands = spectral_offsets_.size() - 1;
+    for (auto value : values) {
+        // Empty history (after reset()) is filled by the first sample
+        if (spectral_buffer_.empty())
+            spectral_buffer_.resize(spectral_buffer_.capacity(), value);
+        else
+            spectral_buffer_.push_back(value);
+        if (++spectral_count_ < spectral_hop_)
+            continue;
+        spectral_count_ = 0;
+        
+        // One FFT per frame, then a sparse dot product per band
+        for (std::size_t n=0; n<spectral_spectrum_.size(); n++)
+            spectral_spectrum_[n] = std::complex<double>(spectral_buffer_[n], 0.);
+        fft_radix2(spectral_spectrum_, spectral_twiddles_);
+        std::size_t frame_offset = frames.size();
+        frames.resize(frame_offset + num_bands);
+        // Padding: before the longest window and after the latest sample, as in update()
+        double prepad_sample = double(spectral_buffer_[spectral_prepad_index_]);
+        double postpad_sample = double(spectral_buffer_.back());
+        for (std::size_t band_index=0; band_index<num_bands; band_index++) {
+            std::complex<double> result = prepad_sample * spectral_pads_[2 * band_index]
+                                          + postpad_sample * spectral_pads_[2 * band_index + 1];
+            for (std::size_t j=spectral_offsets_[band_index]; j<spectral_offsets_[band_index+1]; j++)
+                result += spectral_spectrum_[spectral_bins_[j]] * spectral_kernels_[j];
+            frames[frame_offset + band_index] = result;
+        }
+    }
+}
+
+std::size_t wavelet::Filterbank::spectralMultiplies() const
+{
+    if (spectral_hop_ == 0)
+        return 0;
+    std::size_t fft_size = spectral_spectrum_.size();
+    std::size_t log2_size(0);
+    while ((std::size_t(1) << log2_size) < fft_size)
+        log2_size++;
+    return fft_size / 2 * log2_size + spectral_bins_.size() + spectral_pads_.size();
+}
+
 #ifdef USE_ARMA
 arma::cx_mat wavelet::Filterbank::process(std::vector<double> values)
 {
@@ -395,10 +2860,12 @@ arma::cx_mat wavelet::Filterbank::process(std::vector<double> values)
 
 arma::cx_mat wavelet::Filterbank::process_online(std::vector<double> values)
 {
+    std::vector< std::complex<double> > block_scalogram;
+    update(std::vector<float>(values.begin(), values.end()), block_scalogram);
     arma::cx_mat scalogram(values.size(), size());
     for (std::size_t t=0; t<values.size(); t++) {
-        update(values[t]);
-        scalogram.row(t) = arma::conv_to<arma::cx_rowvec>::from(result_complex);
+        for (std::size_t band_index=0; band_index<size(); band_index++)
+            scalogram(t, band_index) = block_scalogram[t * size() + band_index];
     }
     return scalogram;
 }
@@ -422,6 +2889,15 @@ void wavelet::checkLimits<wavelet::Filterbank::Optimisation>(wavelet::Filterbank
         throw std::domain_error("Attribute value out of range. Range: [" +  std::to_string(limit_min) + " ; " + std::to_string(limit_max) + "]");
 }
 
+template <>
+void wavelet::checkLimits<wavelet::Filterbank::DecimationPolicy>(wavelet::Filterbank::DecimationPolicy const& value,
+                                                                 wavelet::Filterbank::DecimationPolicy const& limit_min,
+                                                                 wavelet::Filterbank::DecimationPolicy const& limit_max)
+{
+    if (value < limit_min || value > limit_max)
+        throw std::domain_error("Attribute value out of range. Range: [" +  std::to_string(limit_min) + " ; " + std::to_string(limit_max) + "]");
+}
+
 template <>
 wavelet::Family wavelet::Attribute<wavelet::Family>::default_limit_max() {
     return wavelet::PAUL;
@@ -429,5 +2905,10 @@ wavelet::Family wavelet::Attribute<wavelet::Family>::default_limit_max() {
 
 template <>
 wavelet::Filterbank::Optimisation wavelet::Attribute<wavelet::Filterbank::Optimisation>::default_limit_max() {
-    return wavelet::Filterbank::AGRESSIVE;
+    return wavelet::Filterbank::ATROUS;
+}
+
+template <>
+wavelet::Filterbank::DecimationPolicy wavelet::Attribute<wavelet::Filterbank::DecimationPolicy>::default_limit_max() {
+    return wavelet::Filterbank::CUSTOM;
 }
@@ -37,7 +37,9 @@
 #include "lowpass.hpp"
 #include "../wavelets/morlet.hpp"
 #include "../wavelets/paul.hpp"
+#include <cstdint>
 #include <map>
+#include <boost/align/aligned_allocator.hpp>
 #include <boost/circular_buffer.hpp>
 #include <boost/throw_exception.hpp>
 #ifdef USE_ARMA
@@ -94,7 +96,67 @@ namespace wavelet {
             /**
              * @brief Agressive Optimisation (Wavelet Downsampling with Signal Downsampling)
              */
-            AGRESSIVE = 2
+            AGRESSIVE = 2,
+            
+            /**
+             * @brief Heterodyne Optimisation (the input is mixed down by the carrier of each band,
+             * decimated to the bandwidth of the band, and convolved with the baseband envelope of its kernel)
+             */
+            HETERODYNE = 3,
+            
+            /**
+             * @brief A trous Optimisation (Wavelet Downsampling with a recursive undecimated dyadic cascade:
+             * each octave is obtained from the previous one by a B3-spline kernel with holes, instead of a low-pass filter per factor)
+             */
+            ATROUS = 4
+        };
+        
+        /**
+         * @brief Quantization policy of the downsampling factors
+         * @details Bands with the same downsampling factor share a decimation stage (low-pass filter and data buffer)
+         */
+        enum DecimationPolicy : unsigned char {
+            /**
+             * @brief Largest integer factor that keeps the band below a quarter of the decimated sampling rate
+             */
+            EXACT = 0,
+            
+            /**
+             * @brief Exact factor rounded down to a power of two
+             */
+            POW2 = 1,
+            
+            /**
+             * @brief Exact factor rounded down to the set of rates given by setDecimationRates()
+             */
+            CUSTOM = 2
+        };
+        
+        /**
+         * @brief Degradation level of the online estimation under a CPU budget (see cpu_budget attribute)
+         * @details Each level includes the degradations of the previous levels
+         */
+        enum Degradation : unsigned char {
+            /**
+             * @brief Nominal quality
+             */
+            NOMINAL = 0,
+            
+            /**
+             * @brief Each band is evaluated once every power-of-two number of frames that keeps the band
+             * below a quarter of its evaluation rate (agressive-style scheduling), and holds its result in between
+             */
+            SKIP_FRAMES = 1,
+            
+            /**
+             * @brief Kernels are truncated with a relative error of -40 dB (unless accuracy is coarser)
+             */
+            SHORT_KERNELS = 2,
+            
+            /**
+             * @brief Kernels are truncated with a relative error of -20 dB (unless accuracy is coarser)
+             */
+            SHORTER_KERNELS = 3
         };
         
 #pragma mark -
@@ -153,11 +215,18 @@ namespace wavelet {
          * frequency_min | float | Minimum Frequency of the Filterbank (Hz) | ]0., samplerate/2.]
          * frequency_max | float | Maximum Frequency of the Filterbank (Hz) | ]0., samplerate/2.]
          * bands_per_octave | float | Number of bands per octave of the Filterbank | > 1.
-         * optimisation | Optimisation | Optimisation mode the filterbank implementation | {NONE, STANDARD, AGRESSIVE}
+         * optimisation | Optimisation | Optimisation mode the filterbank implementation | {NONE, STANDARD, AGRESSIVE, HETERODYNE, ATROUS}
          * family | Family | Wavelet Family | {MORLET, PAUL}
          * samplerate | float |  Sampling rate of the data | ]0.
          * delay | float |  Delay relative to critical wavelet time | > 0.
          * padding | float |  Padding relative to critical wavelet time | >=0.
+         * threads | unsigned int | Number of threads used to compute the wavelet kernels | >= 1
+         * accuracy | float | Maximum relative error of the kernel truncation (dB), 0 disables truncation | <= 0.
+         * lowrank_accuracy | float | Maximum relative error of the low-rank stage kernels (dB), 0 disables the approximation | <= 0.
+         * decimation | DecimationPolicy | Quantization policy of the downsampling factors | {EXACT, POW2, CUSTOM}
+         * predecimation | bool | Decimate the input once for the whole filterbank (driven by frequency_max) | {true, false}
+         * cpu_budget | float | Processing time budget of the online estimation (microseconds per sample), 0 disables the degradation | >= 0.
+         * max_latency | unsigned int | Maximum latency of the FFT-partitioned bands (samples), 0 disables the FFT convolution | >= 0
          *
          * === Wavelet-specific attributes:
          *
@@ -170,11 +239,7 @@ namespace wavelet {
         void setAttribute(std::string attr_name,
                           T attr_value)
         {
-            try {
-                setAttribute_internal(attr_name, boost::any(attr_value));
-            } catch(const boost::bad_any_cast &) {
-                throw std::runtime_error("Argument value type does not match Attribute type");
-            }
+            AttributeHandler::setAttribute(attr_name, attr_value);
         }
         
         /**
@@ -197,6 +262,13 @@ namespace wavelet {
          * samplerate | float |  Sampling rate of the data
          * delay | float |  Delay relative to critical wavelet time
          * padding | float |  Padding relative to critical wavelet time
+         * threads | unsigned int | Number of threads used to compute the wavelet kernels
+         * accuracy | float | Maximum relative error of the kernel truncation (dB)
+         * lowrank_accuracy | float | Maximum relative error of the low-rank stage kernels (dB)
+         * decimation | DecimationPolicy | Quantization policy of the downsampling factors
+         * predecimation | bool | Decimate the input once for the whole filterbank (driven by frequency_max)
+         * cpu_budget | float | Processing time budget of the online estimation (microseconds per sample)
+         * max_latency | unsigned int | Maximum latency of the FFT-partitioned bands (samples)
          *
          * === Wavelet-specific attributes:
          *
@@ -208,13 +280,130 @@ namespace wavelet {
         template <typename T>
         T getAttribute(std::string attr_name) const
         {
-            try {
-                return boost::any_cast<T>(getAttribute_internal(attr_name));
-            } catch(const boost::bad_any_cast &) {
-                throw std::runtime_error("Return value type does not match Attribute type");
-            }
+            return AttributeHandler::getAttribute<T>(attr_name);
+        }
+        
+        /**
+         * @brief set attribute value by identifier
+         * @details Same attributes as setAttribute(std::string, T), without string comparisons.
+         * Does not allocate nor throw exceptions for invalid requests.
+         * @param attr_id attribute identifier
+         * @param attr_value attribute value
+         * @return false if the attribute does not exist for the current wavelet or is not shared among filters,
+         * if the type does not match the attribute's internal type, or if the value exceeds the limits
+         */
+        template <typename T>
+        bool setAttribute(AttributeId attr_id,
+                          T const& attr_value)
+        {
+            return AttributeHandler::setAttribute(attr_id, attr_value);
         }
         
+        /**
+         * @brief get attribute value by identifier
+         * @details Same attributes as getAttribute(std::string), without string comparisons.
+         * Does not allocate nor throw exceptions.
+         * @param attr_id attribute identifier
+         * @param attr_value attribute value (unchanged if the request fails)
+         * @return false if the attribute does not exist for the current wavelet or is not shared among filters,
+         * or if the type does not match the attribute's internal type
+         */
+        template <typename T>
+        bool getAttribute(AttributeId attr_id,
+                          T& attr_value) const
+        {
+            return AttributeHandler::getAttribute(attr_id, attr_value);
+        }
+        
+        /**
+         * @brief set the downsampling factors allowed by the CUSTOM decimation policy
+         * @details each band uses the largest rate that does not exceed its exact downsampling
+         * factor (1 if there is none). The filterbank is reinitialized if the policy is CUSTOM.
+         * @param rates allowed downsampling factors
+         * @throws domain_error if a rate is lower than 1
+         */
+        void setDecimationRates(std::vector<int> const& rates);
+        
+        /**
+         * @brief get the downsampling factors allowed by the CUSTOM decimation policy
+         * @return sorted allowed downsampling factors
+         */
+        std::vector<int> getDecimationRates() const;
+        
+        ///@}
+        
+#pragma mark > Configuration
+        /** @name Configuration */
+        ///@{
+        
+        /**
+         * @brief start a configuration transaction
+         * @details Until commitConfig() is called, attribute changes (through setAttribute
+         * or directly through the public attributes) are stored without reinitializing the filterbank,
+         * and the cross-checks between frequency_min, frequency_max and samplerate are deferred,
+         * so that the attributes can be set in any order.
+         */
+        void beginConfig();
+        
+        /**
+         * @brief validate the pending configuration and initialize the filterbank once
+         * @throws domain_error if the frequency range is not valid. In this case the
+         * transaction remains open so that the configuration can be fixed and committed again.
+         */
+        void commitConfig();
+        
+        ///@}
+        
+#pragma mark > Snapshots
+        /** @name Snapshots */
+        ///@{
+        
+        /**
+         * @brief save the configured filterbank to a binary snapshot file
+         * @details The snapshot stores the attributes, scales, downsampling factors,
+         * wavelet kernels, padding values and low-pass filter coefficients.
+         * The stream state (data buffers and results) is not saved.
+         * @param filename path of the snapshot file
+         * @throws runtime_error if the file cannot be written
+         */
+        void save(std::string const& filename) const;
+        
+        /**
+         * @brief load a binary snapshot written by save()
+         * @details The file is memory-mapped and the kernels are copied as is:
+         * no wavelet function is evaluated. The load is not zero-copy: the kernels are
+         * copied once from the mapping into the wavelets, which own their values, and the
+         * mapping is released before returning. The data buffers are reset.
+         * @param filename path of the snapshot file
+         * @throws runtime_error if the file cannot be read, is corrupted,
+         * or was written with an unsupported version of the format
+         */
+        void load(std::string const& filename);
+        
+        ///@}
+        
+#pragma mark > Streaming State
+        /** @name Streaming State */
+        ///@{
+        
+        /**
+         * @brief serialize the streaming state of the filterbank
+         * @details The state contains the contents of the data buffers, the memory of
+         * the low-pass filters, the frame index and the last results, together with a
+         * fingerprint of the configuration. It can be restored with restoreState() in a
+         * filterbank with the same configuration, so that the output continues sample-exactly.
+         * @return binary state
+         */
+        std::vector<char> saveState() const;
+        
+        /**
+         * @brief restore a streaming state serialized with saveState()
+         * @param state binary state
+         * @throws runtime_error if the state is corrupted or if it was saved from a
+         * filterbank with a different configuration (the current state is left unchanged)
+         */
+        void restoreState(std::vector<char> const& state);
+        
         ///@}
         
 #pragma mark > Online Estimation
@@ -226,6 +415,18 @@ namespace wavelet {
          */
         void update(float value);
         
+        /**
+         * @brief update the filter with a block of incoming values
+         * @details equivalent to calling update() on each value. For each decimation stage, the
+         * overlapping dot products of the block are computed as a product of the kernels with
+         * a Hankel matrix of the decimated samples, tiled over frames so that each kernel
+         * coefficient is reused for a whole tile of frames.
+         * result_complex and result_power hold the results of the last value of the block.
+         * @param values array of incoming values
+         * @param scalogram complex scalogram of the block (C-like array with size: number of values * number of bands)
+         */
+        void update(std::vector<float> const& values, std::vector< std::complex<double> >& scalogram);
+        
         /**
          * @brief clear the current data buffer
          */
@@ -233,6 +434,42 @@ namespace wavelet {
         
         ///@}
         
+#pragma mark > Block Estimation
+        /** @name Block Estimation */
+        ///@{
+        
+        /**
+         * @brief configure the frame-based constant-Q engine
+         * @details Brown-Puckette constant-Q transform: every hop_size input samples, the last
+         * samples (the smallest power of two covering the longest kernel) are transformed by one FFT,
+         * and each band is a sparse complex dot product of the spectrum with the spectrum of its kernel.
+         * The kernel spectra are computed from the kernels of the NONE optimisation mode, so that
+         * the frames are the results of update() in this mode, up to the bins dropped from the kernels.
+         * The engine runs at the input sampling rate and follows the configuration of the filterbank.
+         * @param hop_size number of input samples between two frames (> 0)
+         * @param accuracy maximum relative error of the sparse kernels (dB), 0 keeps every nonzero bin (<= 0)
+         * @throws domain_error if a parameter is out of range
+         */
+        void initSpectral(std::size_t hop_size, float accuracy);
+        
+        /**
+         * @brief update the constant-Q engine with a block of incoming values
+         * @param values array of incoming values
+         * @param frames complex scalogram of the frames completed during the block
+         * (C-like array with size: number of frames * number of bands)
+         * @throws runtime_error if the engine is not configured (see initSpectral())
+         */
+        void updateSpectral(std::vector<float> const& values, std::vector< std::complex<double> >& frames);
+        
+        /**
+         * @brief cost of a frame of the constant-Q engine
+         * @return number of complex multiplies per frame (FFT butterflies, nonzero kernel bins and padding),
+         * 0 if the engine is not configured
+         */
+        std::size_t spectralMultiplies() const;
+        
+        ///@}
+        
 #pragma mark > Offline Estimation
 #ifdef USE_ARMA
         /** @name Offline Estimation */
@@ -275,10 +512,70 @@ namespace wavelet {
         
         /**
          * @brief get the delays in sample for each filter
+         * @details includes the latency of the front-end decimation filter (see predecimation attribute)
          * @return vector of delays in samples
          */
         std::vector<int> delaysInSamples() const;
         
+        /**
+         * @brief get the number of multiply-accumulates saved by the kernel truncation for each band
+         * @return vector of MACs saved per update (see accuracy attribute)
+         */
+        std::vector<std::size_t> macSavings() const;
+        
+        /**
+         * @brief get the memory used by the data buffers and the kernels of the decimation stages
+         * @return memory usage (bytes)
+         */
+        std::size_t stageMemory() const;
+        
+        /**
+         * @brief get the average number of multiplications per input sample
+         * @details counts the low-pass filters of the decimation stages and the kernels
+         * (or low-rank projections) of the bands, averaged over skipped frames in agressive mode
+         * @return multiplications per input sample
+         */
+        double multipliesPerSample() const;
+        
+        /**
+         * @brief get the anti-aliasing margin of each band
+         * @details ratio between the cutoff frequency of the band's low-pass filter and the band's
+         * frequency (infinite if the band is not decimated). In ATROUS optimisation, the cutoff is
+         * the aliasing frequency of the dilated kernel. Coarser downsampling factors increase
+         * the margin, and reduce the aliasing and the attenuation of the upper part of the band.
+         * @return vector of anti-aliasing margins
+         */
+        std::vector<double> aliasingMargins() const;
+        
+        /**
+         * @brief get the current degradation level of the online estimation
+         * @details the level is raised when the average processing time exceeds cpu_budget,
+         * and lowered when the estimated time at the previous level fits in the budget
+         * @return degradation level (NOMINAL if cpu_budget is 0)
+         */
+        Degradation degradation() const;
+        
+        /**
+         * @brief get the average processing time of the online estimation
+         * @details exponential moving average over the last few hundred samples (only measured if cpu_budget > 0)
+         * @return processing time per input sample (microseconds)
+         */
+        double cpuLoad() const;
+        
+        /**
+         * @brief set the on-disk cache consulted when the wavelet kernels are computed
+         * @details kernels found in the cache are memory-mapped instead of being recomputed,
+         * and computed kernels are added to the cache. The current kernels are not recomputed.
+         * @param kernel_cache kernel cache (nullptr to disable caching)
+         */
+        void setKernelCache(std::shared_ptr<KernelCache> kernel_cache);
+        
+        /**
+         * @brief get the on-disk kernel cache
+         * @return kernel cache (nullptr if caching is disabled)
+         */
+        std::shared_ptr<KernelCache> getKernelCache() const;
+        
 #ifdef SWIGPYTHON
         /**
          * @brief "print" method for python => returns the results of write method
@@ -324,6 +621,68 @@ namespace wavelet {
          */
         Attribute<bool> rescale;
         
+        /**
+         * @brief Number of threads used to compute the wavelet kernels
+         * @details the kernels do not depend on the number of threads
+         */
+        Attribute<unsigned int> threads;
+        
+        /**
+         * @brief Maximum relative error of the kernel truncation (dB)
+         * @details The taps at both ends of each kernel are dropped as long as their cumulated
+         * magnitude is below the error budget (relative to the kernel's L1 norm), and their sum is
+         * folded into the padding values. 0 disables truncation.
+         */
+        Attribute<float> accuracy;
+        
+        /**
+         * @brief Maximum relative error of the low-rank approximation of the stage kernels (dB)
+         * @details The kernels of each decimation stage are projected on the smallest orthonormal
+         * basis whose residual energy is below the error budget (relative to the energy of the
+         * kernels): each update convolves the stage samples with the basis filters, and projects
+         * the results to all bands. Stages where this is not cheaper keep their kernels.
+         * 0 disables the approximation.
+         */
+        Attribute<float> lowrank_accuracy;
+        
+        /**
+         * @brief Quantization policy of the downsampling factors
+         * @details Coarser sets of factors (POW2, CUSTOM) collapse the bands onto fewer decimation
+         * stages: fewer low-pass filters and data buffers, at the cost of longer kernels for the
+         * bands whose factor is rounded down.
+         */
+        Attribute<DecimationPolicy> decimation;
+        
+        /**
+         * @brief Decimate the input once for the whole filterbank
+         * @details If frequency_max is far below the Nyquist frequency, the input is low-pass filtered and
+         * decimated by the largest factor that keeps frequency_max below a quarter of the decimated sampling
+         * rate, before any per-band processing. The results are held between decimated samples, and the
+         * group delay of the front-end filter is added to delaysInSamples().
+         */
+        Attribute<bool> predecimation;
+        
+        /**
+         * @brief Processing time budget of the online estimation (microseconds per input sample)
+         * @details If the average processing time of update() exceeds the budget, the quality is degraded
+         * by one level (see Degradation), and restored when the load drops. A level is held for at least
+         * 1024 samples, and is lowered only if its measured speedup predicts a time below 80% of the budget.
+         * The kernels of every level are planned when the budget is set (and when the configuration changes),
+         * so that the levels are switched without allocation; the heterodyne channels and the FFT-partitioned
+         * bands (hence the delays) are kept. Raising the decimation is not a degradation level: it would change
+         * the stages and the delays of the bands, and restart their history. 0 disables the degradation.
+         */
+        Attribute<float> cpu_budget;
+        
+        /**
+         * @brief Maximum latency of the FFT-partitioned bands (input samples)
+         * @details Long kernels of the stages at the input rate can be evaluated by uniformly partitioned
+         * FFT convolution, which delays their results by the block size - 1 (added to delaysInSamples()).
+         * The planner picks the block size (a power of two within the latency) that minimizes the
+         * multiplies of each stage. 0 disables the FFT convolution.
+         */
+        Attribute<unsigned int> max_latency;
+        
         /**
          * @brief Scales of each band in the filterbank
          */
@@ -364,44 +723,686 @@ namespace wavelet {
         void init();
         
         /**
-         * @brief initialize the filter when an attribute changes
-         * @param attr_pointer pointer to the changed attribute
+         * @brief update the bands after a change of the frequency range or of the number of bands per octave
+         * @details The wavelets, results and decimation stages (data buffers and low-pass filters)
+         * that persist in the new configuration are kept, so that the stream history is preserved.
+         * Only new bands and stages are allocated, and the obsolete ones are dropped.
+         * New bands with the same discrete kernel as another band (same width in samples at their
+         * decimated rate, e.g. one octave apart with twice the downsampling factor) copy its kernel.
          */
-        virtual void onAttributeChange(AttributeBase* attr_pointer);
+        void reconfigure();
         
         /**
-         * @brief set attribute value by name
-         * @param attr_name attribute name
-         * @param attr_value attribute value
-         * @throws runtime_error if the attribute does not exist for the current wavelet or is not shared among filters,
-         * or if the type does not match the attribute's internal type
+         * @brief quantize a downsampling factor according to the decimation policy
+         * @param samplerate_ratio exact (real-valued) downsampling factor of the band
+         * @return downsampling factor (>= 1)
          */
-        virtual void setAttribute_internal(std::string attr_name,
-                                           boost::any const& attr_value);
+        int quantizeDownsamplingFactor(double samplerate_ratio) const;
         
         /**
-         * @brief get attribute value by name
-         * @param attr_name attribute name
-         * @throws runtime_error if the attribute does not exist for the current wavelet or is not shared among filters,
-         * or if the type does not match the attribute's internal type
-         * @return attribute value
+         * @brief allocate the decimation stages (data buffers and low-pass filters) of the current bands
+         * @details existing stages are kept (with their history), and unused stages are dropped.
          */
-        virtual boost::any getAttribute_internal(std::string attr_name) const;
+        void initStages();
+        
+        /**
+         * @brief plan the kernels of all degradation levels, and start the heterodyne channels and the partitioned convolutions
+         * @details The nominal plan is built first (see planKernels()), with the heterodyne channels and the
+         * streaming states of the partitioned stages. Under a CPU budget, the plans of the degraded levels are
+         * prebuilt with the same heterodyne and partitioned bands, so that setDegradation() only swaps them.
+         */
+        void packKernels();
+        
+        struct KernelPlan;
+        
+        /**
+         * @brief pack the kernels of all bands into the kernel arena and build the band and stage descriptors
+         * @details Plans the algorithm of each stage with a cost model (multiplies per update): the cost
+         * of every representation allowed by the latency and accuracy limits is computed, and the cheapest
+         * one is kept. The candidates are the kernels of the bands (DIRECT, or SYMMETRIC if cheaper), mixed
+         * with PARTITIONED bands at the block size that minimizes the cost of the stage (stages at the
+         * input rate, blocks within max_latency), the LOWRANK basis of the stage (if its rank fits in the
+         * lowrank_accuracy budget), and the DENSE matrix of the stage (with armadillo).
+         * In HETERODYNE optimisation, bands switch to their heterodyne channel if it is cheaper.
+         * The direct algorithms have no latency, PARTITIONED bands are delayed by the block size - 1,
+         * and HETERODYNE bands by the group delay of their low-pass filter.
+         * @param level degradation level (truncation of the kernels)
+         * @param nominal_plan plan of the nominal level (nullptr to plan the nominal level): degraded levels keep
+         * its partitioned bands and block sizes, so that the latency of the bands does not change
+         */
+        void planKernels(Degradation level, KernelPlan const* nominal_plan);
+        
+        /**
+         * @brief build the heterodyne channels of the bands (HETERODYNE optimisation)
+         * @details The carrier of each kernel is the phase of its lag-1 autocorrelation. The baseband
+         * is decimated so that the envelope of the kernel (above -30 dB) stays below a quarter of the
+         * decimated sampling rate (quantized by the decimation policy). A band uses its channel if
+         * the channel costs fewer multiplies per update than the algorithm planned by packKernels().
+         */
+        void initHeterodyne();
+        
+        /**
+         * @brief update the filter with an incoming value (see update(float), without time measurement)
+         * @param value incoming value
+         */
+        void updateFrame(float value);
+        
+        /**
+         * @brief update the stages with an incoming value (after the front-end decimation)
+         * @param value incoming value at the sampling rate of the stages
+         */
+        void updateStages(float value);
+        
+        /**
+         * @brief update the average processing time, and the degradation level if it is settled
+         * @param elapsed processing time of the last update (microseconds)
+         * @param num_samples number of input samples of the last update
+         */
+        void governCpuLoad(double elapsed, std::size_t num_samples);
+        
+        /**
+         * @brief set the degradation level of the online estimation
+         * @details if the truncation of the kernels changes, the plan of the level is swapped with the current one
+         * (without allocation), or built if it is not prebuilt (cpu_budget is 0)
+         * @param level degradation level
+         */
+        void setDegradation(Degradation level);
+        
+        /**
+         * @brief swap the current plan (band and stage descriptors, kernel arena) with a stored plan
+         * @param plan stored plan
+         */
+        void swapPlan(KernelPlan& plan);
+        
+        struct StageDescriptor;
+        
+        struct PartitionedConvolution;
+        
+        /**
+         * @brief update the stages with a block of incoming values (after the front-end decimation)
+         * @param values array of incoming values at the sampling rate of the stages
+         * @param scalogram complex scalogram of the block (C-like array with size: number of values * number of bands)
+         */
+        void updateBlock(std::vector<float> const& values, std::vector< std::complex<double> >& scalogram);
+        
+        /**
+         * @brief compute the results of a stage for a block of frames
+         * @param stage decimation stage (its data buffer must not contain the samples of the block yet)
+         * @param block_inputs samples of the block at the input of the stage's data buffer (one per frame)
+         * @param block_samples samples of the block stored in the stage's data buffer
+         * @param scalogram complex scalogram of the block (only the frames computed by the stage are written)
+         */
+        void updateStageBlock(StageDescriptor const& stage,
+                              std::vector<float> const& block_inputs,
+                              std::vector<float> const& block_samples,
+                              std::vector< std::complex<double> >& scalogram);
+        
+        /**
+         * @brief compute the latest frequency-domain partitions of a partitioned stage, and the outputs of its bands
+         * @param convolution streaming state of the stage (its history must hold the samples of the frames)
+         * @param num_frames number of new input spectra (1 for a new block, all partitions to restart the convolution)
+         */
+        void updatePartitions(PartitionedConvolution& convolution, std::size_t num_frames);
+        
+        /**
+         * @brief compute the sparse spectral kernels of the constant-Q engine
+         * @details the history of the engine is kept if the FFT size changes
+         */
+        void initSpectralKernels();
+        
+        /**
+         * @brief compute the kernels of a set of bands, in parallel if threads > 1
+         * @param band_indices indices of the bands to initialize
+         */
+        void initWavelets(std::vector<std::size_t> const& band_indices);
+        
+        /**
+         * @brief compute a fingerprint of the current configuration
+         * @details hash of the attributes and of the scales, downsampling factors
+         * and window sizes of the bands
+         * @return configuration fingerprint
+         */
+        std::uint64_t configurationFingerprint() const;
+        
+        /**
+         * @brief resize a data buffer while keeping the most recent history
+         * @param buffer data buffer
+         * @param capacity new capacity
+         */
+        static void resizeKeepingHistory(boost::circular_buffer<float>& buffer, std::size_t capacity);
+        
+        /**
+         * @brief initialize the filter when an attribute changes
+         * @param attr_pointer pointer to the changed attribute
+         */
+        virtual void onAttributeChange(AttributeBase* attr_pointer);
+        
+        /**
+         * @brief get a pointer to an attribute by identifier
+         * @details wavelet attributes are forwarded to the reference wavelet
+         * @param attr_id attribute identifier
+         * @return pointer to the attribute, or nullptr if the attribute does not exist
+         * for the current wavelet or is not shared among filters
+         */
+        virtual AttributeBase* attribute(AttributeId attr_id);
         
         ///@}
         
 #pragma mark -
 #pragma mark === Protected Attributes ===
+        /**
+         * @brief Packed description of a band used by the online estimation
+         */
+        struct BandDescriptor {
+            /**
+             * @brief Algorithm evaluating the band
+             */
+            enum Algorithm : unsigned char {
+                /**
+                 * @brief Dot product with the full conjugate kernel
+                 */
+                DIRECT = 0,
+                
+                /**
+                 * @brief Dot products of the half kernel with the mirrored sample sums and differences
+                 */
+                SYMMETRIC = 1,
+                
+                /**
+                 * @brief Projection of the outputs of the low-rank basis filters of the stage
+                 */
+                LOWRANK = 2,
+                
+                /**
+                 * @brief Row of the dense kernel matrix of the stage (BLAS matrix-vector product)
+                 */
+                DENSE = 3,
+                
+                /**
+                 * @brief Baseband envelope kernel of the band's heterodyne channel
+                 */
+                HETERODYNE = 4,
+                
+                /**
+                 * @brief Uniformly partitioned FFT convolution of the stage (delayed by its block size - 1)
+                 */
+                PARTITIONED = 5
+            };
+            
+            /**
+             * @brief offset of the conjugate kernel in the arena (real parts, followed by imaginary parts).
+             * Symmetric kernels only store their center and right half: the coefficients of the
+             * mirrored sample sums, followed by the coefficients of the mirrored sample differences.
+             */
+            std::size_t offset;
+            
+            /**
+             * @brief number of kernel taps (after truncation)
+             */
+            std::size_t window_size;
+            
+            /**
+             * @brief symmetry of the kernel (ASYMMETRIC if the full kernel is stored)
+             */
+            Wavelet::KernelSymmetry symmetry;
+            
+            /**
+             * @brief number of stored taps per part for symmetric kernels (center and right half)
+             */
+            std::size_t half_size;
+            
+            /**
+             * @brief distance from the end of the data buffer to the sample of the first tap
+             */
+            std::size_t lag;
+            
+            /**
+             * @brief index of the sample of the first tap in the gathered samples of the stage
+             */
+            std::size_t first_sample;
+            
+            /**
+             * @brief decimation factor of the band's stage
+             */
+            std::size_t decimation;
+            
+            /**
+             * @brief conjugate value for pre-padding
+             */
+            std::complex<double> prepad_value;
+            
+            /**
+             * @brief conjugate value for post-padding
+             */
+            std::complex<double> postpad_value;
+            
+            /**
+             * @brief output gain (rescaling and decimation compensation)
+             */
+            double gain;
+            
+            /**
+             * @brief data buffer of the band's stage
+             */
+            boost::circular_buffer<float>* buffer;
+            
+            /**
+             * @brief algorithm evaluating the band (chosen by packKernels())
+             */
+            Algorithm algorithm;
+            
+            /**
+             * @brief modeled cost of the band's algorithm (multiplies per update, shared costs are split among the bands of the stage)
+             */
+            double cost;
+            
+            /**
+             * @brief number of frames between two evaluations of the band if frames are skipped (SKIP_FRAMES degradation)
+             */
+            std::size_t hold;
+            
+            /**
+             * @brief number of frequency-domain partitions of the kernel (PARTITIONED algorithm)
+             */
+            std::size_t partitions;
+            
+            /**
+             * @brief offset of the partition spectra in the arena (PARTITIONED algorithm): spectra of the
+             * consecutive blocks of the kernel in lag order (including the post-padding, the gain and the
+             * inverse FFT normalization), with interleaved real and imaginary parts
+             */
+            std::size_t spectrum_offset;
+        };
+        
+        /**
+         * @brief Description of a decimation stage: bands sharing a data buffer and a decimation factor
+         */
+        struct StageDescriptor {
+            /**
+             * @brief index of the first band of the stage
+             */
+            std::size_t first_band;
+            
+            /**
+             * @brief number of (consecutive) bands of the stage
+             */
+            std::size_t num_bands;
+            
+            /**
+             * @brief number of samples gathered from the data buffer (longest kernel of the stage)
+             */
+            std::size_t length;
+            
+            /**
+             * @brief decimation factor of the stage
+             */
+            std::size_t decimation;
+            
+            /**
+             * @brief data buffer of the stage
+             */
+            boost::circular_buffer<float>* buffer;
+            
+            /**
+             * @brief distance between consecutive samples of the stage in its data buffer
+             * (1 if the buffer is stored at the decimated rate)
+             */
+            std::size_t stride;
+            
+            /**
+             * @brief latest sample at the input of a buffer stored at the decimated rate (nullptr otherwise)
+             */
+            float* latest;
+            
+            /**
+             * @brief rank of the low-rank approximation of the stage kernels (0 if the kernels are used directly)
+             */
+            std::size_t rank;
+            
+            /**
+             * @brief offset of the low-rank basis in the arena: rank basis filters of length samples,
+             * followed by the projection coefficients (real and imaginary rows of each band, rank coefficients per row)
+             */
+            std::size_t basis_offset;
+            
+            /**
+             * @brief number of bands of the stage that read its gathered samples. Bands computed by
+             * heterodyne channels only read the padding samples: if none remains, the gather is skipped
+             */
+            std::size_t gathered_bands;
+            
+            /**
+             * @brief block size of the FFT-partitioned bands of the stage (0 if none)
+             */
+            std::size_t block_size;
+            
+#ifdef USE_ARMA
+            /**
+             * @brief dense kernel matrix of the stage (real and imaginary rows of each band),
+             * only allocated if the kernels fill most of it
+             */
+            arma::mat kernels;
+#endif
+        };
+        
+        /**
+         * @brief Heterodyne channel of a band (HETERODYNE optimisation)
+         * @details The input is mixed down by the carrier of the band's kernel, low-pass filtered and
+         * decimated, and the decimated baseband is convolved with the envelope of the kernel.
+         * The result is modulated back by the carrier at every sample.
+         */
+        struct HeterodyneChannel {
+            /**
+             * @brief decimation factor of the baseband (0 if the band does not use its channel)
+             */
+            std::size_t decimation;
+            
+            /**
+             * @brief mixer phasor of the latest sample: exp(i theta t), with theta the carrier of the kernel (rad/sample)
+             */
+            std::complex<double> phasor;
+            
+            /**
+             * @brief mixer increment per sample: exp(i theta)
+             */
+            std::complex<double> rotation;
+            
+            /**
+             * @brief modulation of the baseband result to the band: exp(i theta (window_size - 1))
+             */
+            std::complex<double> modulation;
+            
+            /**
+             * @brief low-pass filter of the real part of the mixed input
+             */
+            LowpassFilter filter_real;
+            
+            /**
+             * @brief low-pass filter of the imaginary part of the mixed input
+             */
+            LowpassFilter filter_imag;
+            
+            /**
+             * @brief decimated baseband samples
+             */
+            boost::circular_buffer< std::complex<double> > baseband;
+            
+            /**
+             * @brief conjugate envelope of the kernel at the decimated rate (ordered as the baseband samples,
+             * including the decimation compensation)
+             */
+            std::vector< std::complex<double> > envelope;
+            
+            /**
+             * @brief baseband result at the latest decimated sample
+             */
+            std::complex<double> result;
+            
+            /**
+             * @brief index of the next input sample (one sample every decimation is kept)
+             */
+            std::size_t index;
+        };
+        
+        /**
+         * @brief Streaming state of a stage with FFT-partitioned bands (uniformly partitioned overlap-save)
+         * @details Every block size samples, the spectrum of the last two blocks of samples is pushed to a
+         * frequency-domain delay line, multiplied by the partition spectra of each band, and transformed back.
+         * The outputs of a block are emitted during the next block size samples, hence delayed by block size - 1.
+         */
+        struct PartitionedConvolution {
+            /**
+             * @brief index of the stage
+             */
+            std::size_t stage;
+            
+            /**
+             * @brief block size (hop size of the FFT frames, half the FFT size)
+             */
+            std::size_t block_size;
+            
+            /**
+             * @brief number of spectra in the frequency-domain delay line (partitions of the longest kernel)
+             */
+            std::size_t num_partitions;
+            
+            /**
+             * @brief input samples of the stage: frames of the delay line and pre-padding sample of the delayed outputs
+             */
+            boost::circular_buffer<float> history;
+            
+            /**
+             * @brief number of samples since the latest block (outputs emitted in the current block)
+             */
+            std::size_t count;
+            
+            /**
+             * @brief FFT twiddle factors: exp(-2 i pi k / fft_size), k < fft_size / 2
+             */
+            std::vector< std::complex<double> > twiddles;
+            
+            /**
+             * @brief frequency-domain delay line: spectra of the latest frames (the newest one at head)
+             */
+            std::vector< std::complex<double> > spectra;
+            
+            /**
+             * @brief index of the newest spectrum in the delay line
+             */
+            std::size_t head;
+            
+            /**
+             * @brief FFT work buffer
+             */
+            std::vector< std::complex<double> > spectrum;
+            
+            /**
+             * @brief outputs of the latest block (block size outputs per band of the stage, without pre-padding)
+             */
+            std::vector< std::complex<double> > outputs;
+        };
+        
+        /**
+         * @brief Kernel plan of a degradation level (stored while another level is current)
+         */
+        struct KernelPlan {
+            /**
+             * @brief band descriptors
+             */
+            std::vector<BandDescriptor> bands;
+            
+            /**
+             * @brief stage descriptors
+             */
+            std::vector<StageDescriptor> stages;
+            
+            /**
+             * @brief number of multiplies per update of the stage kernels if used directly
+             */
+            std::vector<std::size_t> stage_direct_cost;
+            
+            /**
+             * @brief kernel arena
+             */
+            std::vector<double, boost::alignment::aligned_allocator<double, 64> > kernel_arena;
+        };
+        
+        /**
+         * @brief Band descriptors (ordered as the bands, hence by decimation stage)
+         */
+        std::vector<BandDescriptor> bands_;
+        
+        /**
+         * @brief Stage descriptors (ordered by decimation)
+         */
+        std::vector<StageDescriptor> stages_;
+        
+        /**
+         * @brief Heterodyne channels of the bands (empty if the optimisation is not HETERODYNE)
+         */
+        std::vector<HeterodyneChannel> heterodyne_;
+        
+        /**
+         * @brief Streaming states of the stages with FFT-partitioned bands
+         */
+        std::vector<PartitionedConvolution> partitioned_;
+        
+        /**
+         * @brief Number of multiplies per update of the stage kernels if used directly (band by band, same order as stages_)
+         */
+        std::vector<std::size_t> stage_direct_cost_;
+        
+        /**
+         * @brief Samples of the current stage, gathered from its circular buffer at the decimated rate
+         */
+        std::vector<double, boost::alignment::aligned_allocator<double, 64> > stage_samples_;
+        
+        /**
+         * @brief Outputs of the basis filters of the current low-rank stage (for a tile of frames)
+         */
+        std::vector<double> stage_projections_;
+        
+        /**
+         * @brief Kernel arena: conjugate kernels of all bands, stored contiguously
+         * (each kernel is aligned on a cache line). Bands with the same kernel share a single copy.
+         */
+        std::vector<double, boost::alignment::aligned_allocator<double, 64> > kernel_arena_;
+        
         /**
          * @brief Data buffer (circular buffer shared among bands associated with the same samplerate)
+         * @details In ATROUS optimisation, every dyadic level is stored at the input rate, and computed
+         * from the previous level (the a trous cascade reads 5 taps of the previous buffer).
          */
         std::map<int, boost::circular_buffer<float>> data_;
         
+        /**
+         * @brief Latest input sample of the data buffers stored at the decimated rate (agressive optimisation)
+         * @details In agressive mode, a stage is only evaluated once every decimation factor frames, hence
+         * its buffer only stores the samples read by the kernels. The latest sample is kept for post-padding.
+         */
+        std::map<int, float> data_latest_;
+        
         /**
          * @brief Low-pass Filters for decimation
          */
         std::map<int, LowpassFilter> filters_;
         
+        /**
+         * @brief Downsampling factors allowed by the CUSTOM decimation policy (sorted, without duplicates)
+         */
+        std::vector<int> decimation_rates_;
+        
+        /**
+         * @brief Decimation factor of the front-end stage (1 if the input is not pre-decimated)
+         */
+        int frontend_factor_;
+        
+        /**
+         * @brief Low-pass filter of the front-end stage
+         */
+        LowpassFilter frontend_filter_;
+        
+        /**
+         * @brief Index of the next input sample of the front-end stage (one sample every frontend_factor_ is kept)
+         */
+        std::size_t frontend_index_;
+        
+        /**
+         * @brief Number of input samples between two frames of the constant-Q engine (0 if not configured)
+         */
+        std::size_t spectral_hop_;
+        
+        /**
+         * @brief Maximum relative error of the sparse spectral kernels (dB)
+         */
+        float spectral_accuracy_;
+        
+        /**
+         * @brief Number of input samples since the last frame of the constant-Q engine
+         */
+        std::size_t spectral_count_;
+        
+        /**
+         * @brief Configuration fingerprint of the spectral kernels
+         */
+        std::uint64_t spectral_fingerprint_;
+        
+        /**
+         * @brief Input history of the constant-Q engine (one FFT frame)
+         */
+        boost::circular_buffer<float> spectral_buffer_;
+        
+        /**
+         * @brief FFT twiddle factors: exp(-2 i pi k / fft_size), k < fft_size / 2
+         */
+        std::vector< std::complex<double> > spectral_twiddles_;
+        
+        /**
+         * @brief Spectrum of the current frame of the constant-Q engine
+         */
+        std::vector< std::complex<double> > spectral_spectrum_;
+        
+        /**
+         * @brief Offset of the nonzero bins of each band in spectral_bins_ (number of bands + 1)
+         */
+        std::vector<std::size_t> spectral_offsets_;
+        
+        /**
+         * @brief Frequency bins of the nonzero coefficients of the spectral kernels
+         */
+        std::vector<std::size_t> spectral_bins_;
+        
+        /**
+         * @brief Nonzero coefficients of the spectral kernels (including gain and FFT normalization)
+         */
+        std::vector< std::complex<double> > spectral_kernels_;
+        
+        /**
+         * @brief Padding values of the bands in the constant-Q engine (before, after; including gain)
+         */
+        std::vector< std::complex<double> > spectral_pads_;
+        
+        /**
+         * @brief Index in the frame of the sample multiplied by the padding before the kernels
+         */
+        std::size_t spectral_prepad_index_;
+        
+        /**
+         * @brief Current degradation level of the online estimation
+         */
+        Degradation degradation_;
+        
+        /**
+         * @brief Average processing time per input sample (microseconds)
+         */
+        double cpu_load_;
+        
+        /**
+         * @brief Number of input samples measured since the last change of degradation level
+         */
+        std::size_t cpu_samples_;
+        
+        /**
+         * @brief Defines if the processing time of the current update is being measured (nested updates are not measured)
+         */
+        bool cpu_timing_;
+        
+        /**
+         * @brief Average processing time before the last increase of the degradation level
+         */
+        double degradation_entry_load_;
+        
+        /**
+         * @brief Kernel plans of the degradation levels (indexed by level, levels with the same truncation share the slot
+         * of the first one). The slot of the current level is empty: its plan is in bands_, stages_, stage_direct_cost_ and kernel_arena_.
+         */
+        std::vector<KernelPlan> plans_;
+        
+        /**
+         * @brief Measured speedup of each degradation level over the previous one (0 if not measured yet)
+         */
+        std::vector<double> degradation_speedups_;
+        
         /**
          * @brief Wavelets
          */
@@ -417,6 +1418,22 @@ namespace wavelet {
          */
         int frame_index_;
         
+        /**
+         * @brief Defines if a configuration transaction is in progress
+         */
+        bool config_transaction_;
+        
+        /**
+         * @brief Defines if the configuration changed since the transaction started
+         */
+        bool config_changed_;
+        
+        /**
+         * @brief Defines if the pending configuration requires a complete initialization
+         * (otherwise the bands are reconfigured incrementally)
+         */
+        bool config_full_init_;
+        
         ///@endcond
     };
     
@@ -433,11 +1450,19 @@ namespace wavelet {
                                                Filterbank::Optimisation const& limit_min,
                                                Filterbank::Optimisation const& limit_max);
     
+    template <>
+    void checkLimits<Filterbank::DecimationPolicy>(Filterbank::DecimationPolicy const& value,
+                                                   Filterbank::DecimationPolicy const& limit_min,
+                                                   Filterbank::DecimationPolicy const& limit_max);
+    
     template <>
     Family Attribute<Family>::default_limit_max();
     
     template <>
     Filterbank::Optimisation Attribute<Filterbank::Optimisation>::default_limit_max();
+    
+    template <>
+    Filterbank::DecimationPolicy Attribute<Filterbank::DecimationPolicy>::default_limit_max();
     ///@endcond
 }
 
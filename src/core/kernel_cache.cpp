@@ -0,0 +1,184 @@
+/*
+ * kernel_cache.cpp
+ *
+ * Persistent on-disk cache of wavelet kernels
+ *
+ * Contact:
+ * - Jules Françoise <jules.francoise@ircam.fr>
+ *
+ * This code has been authored by <a href="http://julesfrancoise.com">Jules Françoise</a>
+ * in the framework of the <a href="http://skatvg.iuav.it/">SkAT-VG</a> European project,
+ * with <a href="frederic-bevilacqua.net">Frederic Bevilacqua</a>, in the
+ * <a href="http://ismm.ircam.fr">Sound Music Movement Interaction</a> team of the
+ * <a href="http://www.ircam.fr/stms.html?&L=1">STMS Lab</a> - IRCAM - CNRS - UPMC (2011-2015).
+ *
+ * Copyright (C) 2015 Ircam-Centre Pompidou.
+ *
+ * This File is part of Wavelet.
+ *
+ * Wavelet is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wavelet is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wavelet.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "kernel_cache.hpp"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+namespace {
+    /**
+     * @brief Identifier of the kernel cache files
+     */
+    const char kernel_magic[4] = {'W', 'V', 'L', 'K'};
+    
+    /**
+     * @brief Version of the kernel cache file format
+     */
+    const std::uint32_t kernel_version = 1;
+    
+    /**
+     * @brief Size of the fixed part of the header (magic, version, number of parameters)
+     */
+    const std::size_t kernel_header_size = sizeof(kernel_magic) + sizeof(std::uint32_t) + sizeof(std::uint64_t);
+}
+
+wavelet::KernelCache::KernelCache(std::string const& directory) :
+directory_(directory)
+{
+    if (!directory_.empty() && directory_[directory_.size() - 1] != '/')
+        directory_ += '/';
+}
+
+std::string wavelet::KernelCache::directory() const
+{
+    return directory_;
+}
+
+std::string wavelet::KernelCache::path(std::vector<double> const& parameters) const
+{
+    std::stringstream pathstream;
+    pathstream << directory_ << "kernel_" << std::hex << std::setw(16) << std::setfill('0')
+    << hash(parameters.data(), parameters.size() * sizeof(double)) << ".wvk";
+    return pathstream.str();
+}
+
+bool wavelet::KernelCache::load(std::vector<double> const& parameters,
+                                std::vector< std::complex<double> >& values,
+                                std::complex<double>& prepad_value,
+                                std::complex<double>& postpad_value) const
+{
+    boost::interprocess::mapped_region region;
+    try {
+        boost::interprocess::file_mapping mapping(path(parameters).c_str(), boost::interprocess::read_only);
+        boost::interprocess::mapped_region(mapping, boost::interprocess::read_only).swap(region);
+    } catch (boost::interprocess::interprocess_exception const&) {
+        return false;
+    }
+    const char* data = static_cast<const char*>(region.get_address());
+    std::size_t size = region.get_size();
+    
+    // Header: magic, version, parameters
+    std::size_t parameters_size = parameters.size() * sizeof(double);
+    std::size_t prefix_size = kernel_header_size + parameters_size + sizeof(std::uint64_t) + 2 * sizeof(std::complex<double>);
+    if (size < prefix_size + sizeof(std::uint64_t))
+        return false;
+    std::uint32_t version;
+    std::uint64_t num_parameters;
+    std::memcpy(&version, data + sizeof(kernel_magic), sizeof(version));
+    std::memcpy(&num_parameters, data + sizeof(kernel_magic) + sizeof(version), sizeof(num_parameters));
+    if (std::memcmp(data, kernel_magic, sizeof(kernel_magic)) != 0 ||
+        version != kernel_version ||
+        num_parameters != parameters.size() ||
+        std::memcmp(data + kernel_header_size, parameters.data(), parameters_size) != 0)
+        return false;
+    
+    // Size and checksum
+    std::uint64_t window_size;
+    std::memcpy(&window_size, data + kernel_header_size + parameters_size, sizeof(window_size));
+    if (window_size > (size - prefix_size - sizeof(std::uint64_t)) / sizeof(std::complex<double>) ||
+        size != prefix_size + window_size * sizeof(std::complex<double>) + sizeof(std::uint64_t))
+        return false;
+    std::uint64_t checksum;
+    std::memcpy(&checksum, data + size - sizeof(checksum), sizeof(checksum));
+    if (checksum != hash(data, size - sizeof(checksum)))
+        return false;
+    
+    const char* position = data + kernel_header_size + parameters_size + sizeof(window_size);
+    std::memcpy(&prepad_value, position, sizeof(std::complex<double>));
+    position += sizeof(std::complex<double>);
+    std::memcpy(&postpad_value, position, sizeof(std::complex<double>));
+    position += sizeof(std::complex<double>);
+    values.resize(window_size);
+    std::memcpy(values.data(), position, window_size * sizeof(std::complex<double>));
+    return true;
+}
+
+bool wavelet::KernelCache::store(std::vector<double> const& parameters,
+                                 std::vector< std::complex<double> > const& values,
+                                 std::complex<double> const& prepad_value,
+                                 std::complex<double> const& postpad_value) const
+{
+    std::vector<char> buffer;
+    std::uint64_t num_parameters(parameters.size());
+    std::uint64_t window_size(values.size());
+    buffer.insert(buffer.end(), kernel_magic, kernel_magic + sizeof(kernel_magic));
+    buffer.insert(buffer.end(), reinterpret_cast<const char*>(&kernel_version), reinterpret_cast<const char*>(&kernel_version) + sizeof(kernel_version));
+    buffer.insert(buffer.end(), reinterpret_cast<const char*>(&num_parameters), reinterpret_cast<const char*>(&num_parameters) + sizeof(num_parameters));
+    buffer.insert(buffer.end(), reinterpret_cast<const char*>(parameters.data()), reinterpret_cast<const char*>(parameters.data() + parameters.size()));
+    buffer.insert(buffer.end(), reinterpret_cast<const char*>(&window_size), reinterpret_cast<const char*>(&window_size) + sizeof(window_size));
+    buffer.insert(buffer.end(), reinterpret_cast<const char*>(&prepad_value), reinterpret_cast<const char*>(&prepad_value) + sizeof(prepad_value));
+    buffer.insert(buffer.end(), reinterpret_cast<const char*>(&postpad_value), reinterpret_cast<const char*>(&postpad_value) + sizeof(postpad_value));
+    buffer.insert(buffer.end(), reinterpret_cast<const char*>(values.data()), reinterpret_cast<const char*>(values.data() + values.size()));
+    std::uint64_t checksum = hash(buffer.data(), buffer.size());
+    buffer.insert(buffer.end(), reinterpret_cast<const char*>(&checksum), reinterpret_cast<const char*>(&checksum) + sizeof(checksum));
+    
+    // Write to a unique temporary file, then atomically move it to its final location
+    static std::atomic<unsigned int> counter(0);
+    static const unsigned int process_token = std::random_device()();
+    std::string filename = path(parameters);
+    std::stringstream tmpstream;
+    tmpstream << filename << ".tmp." << std::hex << process_token << "." << counter++;
+    std::string tmp_filename = tmpstream.str();
+    {
+        std::ofstream stream(tmp_filename.c_str(), std::ios::binary | std::ios::trunc);
+        if (!stream.is_open())
+            return false;
+        stream.write(buffer.data(), buffer.size());
+        stream.close();
+        if (stream.fail()) {
+            std::remove(tmp_filename.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+        std::remove(tmp_filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::uint64_t wavelet::KernelCache::hash(const void* data, std::size_t size, std::uint64_t hash)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i=0; i<size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
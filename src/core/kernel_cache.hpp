@@ -0,0 +1,148 @@
+/*
+ * kernel_cache.hpp
+ *
+ * Persistent on-disk cache of wavelet kernels
+ *
+ * Contact:
+ * - Jules Françoise <jules.francoise@ircam.fr>
+ *
+ * This code has been authored by <a href="http://julesfrancoise.com">Jules Françoise</a>
+ * in the framework of the <a href="http://skatvg.iuav.it/">SkAT-VG</a> European project,
+ * with <a href="frederic-bevilacqua.net">Frederic Bevilacqua</a>, in the
+ * <a href="http://ismm.ircam.fr">Sound Music Movement Interaction</a> team of the
+ * <a href="http://www.ircam.fr/stms.html?&L=1">STMS Lab</a> - IRCAM - CNRS - UPMC (2011-2015).
+ *
+ * Copyright (C) 2015 Ircam-Centre Pompidou.
+ *
+ * This File is part of Wavelet.
+ *
+ * Wavelet is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wavelet is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wavelet.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __wavelet__kernel_cache__
+#define __wavelet__kernel_cache__
+
+#include <complex>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace wavelet {
+    /**
+     * @class KernelCache
+     * @brief Persistent on-disk cache of wavelet kernels
+     * @details Each kernel is stored in its own file in the cache directory, named after a hash
+     * of the kernel parameters. Files are read through a memory mapping, and their header
+     * (parameters, size) and checksum are verified before use. Files are written to a
+     * temporary file and atomically renamed, so that several processes can populate
+     * the same cache concurrently.
+     */
+    class KernelCache {
+    public:
+#pragma mark -
+#pragma mark === Public Interface ===
+#pragma mark > Constructors
+        /** @name Constructors */
+        ///@{
+        
+        /**
+         * @brief Constructor
+         * @param directory cache directory (must exist)
+         */
+        KernelCache(std::string const& directory);
+        
+        ///@}
+        
+#pragma mark > Accessors
+        /** @name Accessors */
+        ///@{
+        
+        /**
+         * @brief get the cache directory
+         * @return cache directory
+         */
+        std::string directory() const;
+        
+        /**
+         * @brief get the path of the cache file associated with a set of kernel parameters
+         * @param parameters kernel parameters
+         * @return path of the cache file
+         */
+        std::string path(std::vector<double> const& parameters) const;
+        
+        ///@}
+        
+#pragma mark > Cache access
+        /** @name Cache access */
+        ///@{
+        
+        /**
+         * @brief look up a kernel in the cache
+         * @details the entry is validated in place in the memory mapping, then copied once
+         * into values (the mapping is not kept alive after the call)
+         * @param parameters kernel parameters
+         * @param values kernel values (filled if the kernel is found)
+         * @param prepad_value pre-padding value (filled if the kernel is found)
+         * @param postpad_value post-padding value (filled if the kernel is found)
+         * @return true if a valid cache entry was found. Missing, corrupted or
+         * mismatching entries are reported as cache misses.
+         */
+        bool load(std::vector<double> const& parameters,
+                  std::vector< std::complex<double> >& values,
+                  std::complex<double>& prepad_value,
+                  std::complex<double>& postpad_value) const;
+        
+        /**
+         * @brief store a kernel in the cache
+         * @details errors (e.g. read-only directory) are ignored: the cache is only an optimization.
+         * @param parameters kernel parameters
+         * @param values kernel values
+         * @param prepad_value pre-padding value
+         * @param postpad_value post-padding value
+         * @return true if the kernel was written to the cache
+         */
+        bool store(std::vector<double> const& parameters,
+                   std::vector< std::complex<double> > const& values,
+                   std::complex<double> const& prepad_value,
+                   std::complex<double> const& postpad_value) const;
+        
+        ///@}
+        
+        ///@cond DEVDOC
+#ifndef WAVELET_TESTING
+    protected:
+#endif
+#pragma mark -
+#pragma mark === Protected Methods ===
+        /**
+         * @brief FNV-1a hash of a byte sequence
+         * @param data pointer to the data
+         * @param size size in bytes
+         * @param hash initial value of the hash
+         * @return hash value
+         */
+        static std::uint64_t hash(const void* data, std::size_t size, std::uint64_t hash = 14695981039346656037ULL);
+        
+#pragma mark -
+#pragma mark === Protected Attributes ===
+        /**
+         * @brief cache directory
+         */
+        std::string directory_;
+        
+        ///@endcond
+    };
+}
+
+#endif
@@ -45,15 +45,29 @@ rippleLevel(this, rippleLevel_)
 
 wavelet::LowpassFilter::LowpassFilter(LowpassFilter const& src)
 {
+    this->cutoff = src.cutoff;
+    this->cutoff.set_parent(this);
+    this->order = src.order;
+    this->order.set_parent(this);
+    this->rippleLevel = src.rippleLevel;
+    this->rippleLevel.set_parent(this);
     b = src.b;
     a = src.a;
+    z = src.z;
 }
 
 wavelet::LowpassFilter& wavelet::LowpassFilter::operator=(LowpassFilter const& src)
 {
     if(this != &src) {
+        this->cutoff = src.cutoff;
+        this->cutoff.set_parent(this);
+        this->order = src.order;
+        this->order.set_parent(this);
+        this->rippleLevel = src.rippleLevel;
+        this->rippleLevel.set_parent(this);
         b = src.b;
         a = src.a;
+        z = src.z;
     }
     return *this;
 }
@@ -43,6 +43,8 @@ namespace wavelet {
      * @brief Chebyshev Type 1 low-pass Filter
      */
     class LowpassFilter : public AttributeHandler {
+        friend class Filterbank;
+        
     public:
 #pragma mark -
 #pragma mark === Public Interface ===
@@ -0,0 +1,239 @@
+/*
+ * tuner.cpp
+ *
+ * Offline tuning of the filterbank optimisation settings
+ *
+ * Contact:
+ * - Jules Françoise <jules.francoise@ircam.fr>
+ *
+ * This code has been authored by <a href="http://julesfrancoise.com">Jules Françoise</a>
+ * in the framework of the <a href="http://skatvg.iuav.it/">SkAT-VG</a> European project,
+ * with <a href="frederic-bevilacqua.net">Frederic Bevilacqua</a>, in the
+ * <a href="http://ismm.ircam.fr">Sound Music Movement Interaction</a> team of the
+ * <a href="http://www.ircam.fr/stms.html?&L=1">STMS Lab</a> - IRCAM - CNRS - UPMC (2011-2015).
+ *
+ * Copyright (C) 2015 Ircam-Centre Pompidou.
+ *
+ * This File is part of Wavelet.
+ *
+ * Wavelet is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wavelet is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wavelet.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tuner.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+    /**
+     * @brief Names of the optimisation modes (info)
+     */
+    const char* optimisation_names[] = {"NONE", "STANDARD", "AGRESSIVE", "HETERODYNE", "ATROUS"};
+    
+    /**
+     * @brief Number of timed runs of each configuration (the fastest run is kept)
+     */
+    const unsigned int timing_runs = 3;
+}
+
+wavelet::Tuner::Tuner(float samplerate,
+                      float frequency_min,
+                      float frequency_max,
+                      float bands_per_octave_) :
+optimisations({Filterbank::NONE, Filterbank::STANDARD, Filterbank::AGRESSIVE, Filterbank::HETERODYNE, Filterbank::ATROUS}),
+delays({1., 1.5, 2.}),
+paddings({0., 1.}),
+bands_per_octave({bands_per_octave_}),
+family(DEFAULT_FAMILY),
+cpu_budget(0.),
+tolerance(-20.),
+samplerate_(samplerate),
+frequency_min_(frequency_min),
+frequency_max_(frequency_max)
+{
+    if (!(frequency_min > 0.) || !(frequency_max >= frequency_min) || !(frequency_max <= samplerate / 2.))
+        throw std::domain_error("The frequency range must be in ]0, samplerate/2]");
+}
+
+wavelet::Tuner::Candidate wavelet::Tuner::tune(std::vector<float> const& values)
+{
+    if (tolerance > 0.)
+        throw std::domain_error("The error tolerance must be negative or zero (dB)");
+    if (cpu_budget < 0.)
+        throw std::domain_error("The CPU budget must be positive or zero");
+    if (optimisations.empty() || delays.empty() || paddings.empty() || bands_per_octave.empty())
+        throw std::domain_error("The lists of candidate settings must not be empty");
+    std::vector<float> signal = values.empty() ? syntheticSignal() : values;
+    candidates_.clear();
+    for (auto bpo : bands_per_octave) {
+        // Reference scalogram of the bands, and its delay per band
+        Candidate reference_settings;
+        reference_settings.optimisation = Filterbank::NONE;
+        reference_settings.delay = *std::max_element(delays.begin(), delays.end());
+        reference_settings.padding = *std::max_element(paddings.begin(), paddings.end());
+        reference_settings.bands_per_octave = bpo;
+        std::unique_ptr<Filterbank> reference = filterbank(reference_settings);
+        std::size_t num_bands = reference->size();
+        std::vector<double> reference_magnitudes(signal.size() * num_bands);
+#ifdef USE_ARMA
+        // The offline scalogram is centered on each sample: no delay
+        std::vector<int> reference_delays(num_bands, 0);
+        arma::cx_mat offline_scalogram = reference->process(std::vector<double>(signal.begin(), signal.end()));
+        for (std::size_t t=0; t<signal.size(); t++) {
+            for (std::size_t i=0; i<num_bands; i++)
+                reference_magnitudes[t * num_bands + i] = std::abs(offline_scalogram(t, i));
+        }
+#else
+        std::vector<int> reference_delays = reference->delaysInSamples();
+        std::vector< std::complex<double> > reference_scalogram;
+        reference->update(signal, reference_scalogram);
+        for (std::size_t k=0; k<reference_scalogram.size(); k++)
+            reference_magnitudes[k] = std::abs(reference_scalogram[k]);
+#endif
+        
+        for (auto optimisation : optimisations) {
+            for (auto delay : delays) {
+                for (auto padding : paddings) {
+                    Candidate candidate;
+                    candidate.optimisation = optimisation;
+                    candidate.delay = delay;
+                    candidate.padding = padding;
+                    candidate.bands_per_octave = bpo;
+                    std::unique_ptr<Filterbank> tested = filterbank(candidate);
+                    
+                    // Processing time: fastest of a few runs from a cleared state.
+                    // All candidates are timed on the per-sample update: the block update
+                    // falls back to it for some modes, which would bias the comparison.
+                    std::vector< std::complex<double> > scalogram(signal.size() * num_bands);
+                    candidate.time = std::numeric_limits<double>::infinity();
+                    for (unsigned int run=0; run<timing_runs; run++) {
+                        tested->reset();
+                        auto start = std::chrono::steady_clock::now();
+                        for (std::size_t t=0; t<signal.size(); t++) {
+                            tested->update(signal[t]);
+                            std::copy(tested->result_complex.begin(), tested->result_complex.end(), scalogram.begin() + t * num_bands);
+                        }
+                        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+                        candidate.time = std::min(candidate.time, elapsed.count() / double(signal.size()));
+                    }
+                    candidate.multiplies = tested->multipliesPerSample();
+                    
+                    // Error of the magnitudes: each band is aligned with the reference, after the longest delay
+                    std::vector<int> tested_delays = tested->delaysInSamples();
+                    int max_delay = std::max(*std::max_element(tested_delays.begin(), tested_delays.end()),
+                                             *std::max_element(reference_delays.begin(), reference_delays.end()));
+                    candidate.latency = *std::max_element(tested_delays.begin(), tested_delays.end());
+                    double error(0.);
+                    double energy(0.);
+                    for (std::size_t i=0; i<num_bands; i++) {
+                        for (std::size_t t=2*max_delay; t+max_delay<signal.size(); t++) {
+                            double magnitude = std::abs(scalogram[(t + tested_delays[i]) * num_bands + i]);
+                            double reference_magnitude = reference_magnitudes[(t + reference_delays[i]) * num_bands + i];
+                            error += (magnitude - reference_magnitude) * (magnitude - reference_magnitude);
+                            energy += reference_magnitude * reference_magnitude;
+                        }
+                    }
+                    if (!(energy > 0.))
+                        throw std::runtime_error("The test signal is too short for the frequency range");
+                    candidate.error = 10. * std::log10(std::max(error / energy, 1e-30));
+                    candidate.feasible = (candidate.error <= tolerance) && (cpu_budget == 0. || candidate.time <= cpu_budget);
+                    candidates_.push_back(candidate);
+                }
+            }
+        }
+    }
+    auto best_it = candidates_.end();
+    for (auto candidate_it = candidates_.begin(); candidate_it != candidates_.end(); candidate_it++) {
+        if (candidate_it->feasible && (best_it == candidates_.end() || candidate_it->time < best_it->time))
+            best_it = candidate_it;
+    }
+    if (best_it == candidates_.end())
+        throw std::runtime_error("No configuration meets the error tolerance and the CPU budget");
+    return *best_it;
+}
+
+void wavelet::Tuner::configure(Filterbank& filterbank, Candidate const& candidate)
+{
+    filterbank.beginConfig();
+    filterbank.optimisation.set(candidate.optimisation);
+    filterbank.bands_per_octave.set(candidate.bands_per_octave);
+    filterbank.setAttribute<float>("delay", candidate.delay);
+    filterbank.setAttribute<float>("padding", candidate.padding);
+    filterbank.commitConfig();
+}
+
+std::vector<wavelet::Tuner::Candidate> const& wavelet::Tuner::candidates() const
+{
+    return candidates_;
+}
+
+std::vector<float> wavelet::Tuner::syntheticSignal() const
+{
+    // Long enough to cover the longest kernel (lowest frequency, largest delay) several times
+    Candidate longest;
+    longest.optimisation = Filterbank::NONE;
+    longest.delay = *std::max_element(delays.begin(), delays.end());
+    longest.padding = 0.;
+    longest.bands_per_octave = *std::min_element(bands_per_octave.begin(), bands_per_octave.end());
+    std::vector<int> longest_delays = filterbank(longest)->delaysInSamples();
+    std::size_t length = std::max(static_cast<std::size_t>(samplerate_),
+                                  static_cast<std::size_t>(12 * *std::max_element(longest_delays.begin(), longest_delays.end())));
+    std::vector<float> values(length);
+    std::mt19937 generator(1234);
+    std::normal_distribution<float> noise(0., 0.1);
+    double duration = double(length) / samplerate_;
+    double sweep_rate = std::log(double(frequency_max_) / double(frequency_min_)) / duration;
+    std::size_t impulse_period = length / 7 + 1;
+    for (std::size_t t=0; t<length; t++) {
+        double time = double(t) / samplerate_;
+        double phase = (sweep_rate > 0.) ? 2. * M_PI * frequency_min_ * (std::exp(sweep_rate * time) - 1.) / sweep_rate : 2. * M_PI * frequency_min_ * time;
+        values[t] = float(std::sin(phase)) + noise(generator);
+        if (t % impulse_period == impulse_period / 2)
+            values[t] += 1.;
+    }
+    return values;
+}
+
+std::string wavelet::Tuner::info() const
+{
+    std::stringstream infostrstream;
+    infostrstream << "Filterbank Tuner:\n";
+    infostrstream << "\tFrequency Range: " << frequency_min_ << " " << frequency_max_ << "\n";
+    infostrstream << "\tCPU budget (us per sample): " << cpu_budget << ", Error tolerance (dB): " << tolerance << "\n";
+    infostrstream << "\tCandidates (optimisation, delay, padding, bands per octave: error (dB), time (us per sample), multiplies per sample, latency (samples)):\n";
+    infostrstream << std::fixed << std::setprecision(2);
+    for (auto const& candidate : candidates_) {
+        infostrstream << "\t\t" << (candidate.feasible ? "* " : "  ") << optimisation_names[candidate.optimisation]
+        << ", " << candidate.delay << ", " << candidate.padding << ", " << candidate.bands_per_octave
+        << ": " << candidate.error << ", " << candidate.time << ", " << candidate.multiplies << ", " << candidate.latency << "\n";
+    }
+    return infostrstream.str();
+}
+
+std::unique_ptr<wavelet::Filterbank> wavelet::Tuner::filterbank(Candidate const& candidate) const
+{
+    std::unique_ptr<Filterbank> configured(new Filterbank(samplerate_, frequency_min_, frequency_max_, candidate.bands_per_octave));
+    configured->beginConfig();
+    configured->family.set(family);
+    configured->optimisation.set(candidate.optimisation);
+    configured->setAttribute<float>("delay", candidate.delay);
+    configured->setAttribute<float>("padding", candidate.padding);
+    configured->commitConfig();
+    return configured;
+}
@@ -0,0 +1,250 @@
+/*
+ * tuner.hpp
+ *
+ * Offline tuning of the filterbank optimisation settings
+ *
+ * Contact:
+ * - Jules Françoise <jules.francoise@ircam.fr>
+ *
+ * This code has been authored by <a href="http://julesfrancoise.com">Jules Françoise</a>
+ * in the framework of the <a href="http://skatvg.iuav.it/">SkAT-VG</a> European project,
+ * with <a href="frederic-bevilacqua.net">Frederic Bevilacqua</a>, in the
+ * <a href="http://ismm.ircam.fr">Sound Music Movement Interaction</a> team of the
+ * <a href="http://www.ircam.fr/stms.html?&L=1">STMS Lab</a> - IRCAM - CNRS - UPMC (2011-2015).
+ *
+ * Copyright (C) 2015 Ircam-Centre Pompidou.
+ *
+ * This File is part of Wavelet.
+ *
+ * Wavelet is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Wavelet is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Wavelet.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __wavelet__tuner__
+#define __wavelet__tuner__
+
+#include "filterbank.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace wavelet {
+    /**
+     * @class Tuner
+     * @brief Offline tuning of the optimisation settings of a Filterbank
+     * @details Every combination of the candidate optimisation modes, delays, paddings and numbers
+     * of bands per octave is run on a test signal (synthetic or supplied). Its processing time (per-sample
+     * update) and its error against a reference scalogram of the same bands are measured, and the
+     * fastest configuration that meets the error tolerance and the CPU budget is selected.
+     * The reference is the offline (FFT) scalogram computed by Filterbank::process if the library
+     * is compiled with armadillo, and the online scalogram without optimisation (with the largest
+     * candidate delay and padding) otherwise. The error is the relative RMS error of the magnitudes,
+     * after compensation of the delay of each band (see Filterbank::delaysInSamples).
+     */
+    class Tuner {
+    public:
+        /**
+         * @brief Tuning result of a Filterbank configuration
+         */
+        struct Candidate {
+            /**
+             * @brief Optimisation mode
+             */
+            Filterbank::Optimisation optimisation;
+            
+            /**
+             * @brief Delay relative to critical wavelet time
+             */
+            float delay;
+            
+            /**
+             * @brief Padding relative to critical wavelet time
+             */
+            float padding;
+            
+            /**
+             * @brief Number of bands per octave
+             */
+            float bands_per_octave;
+            
+            /**
+             * @brief Relative error of the magnitudes against the reference (dB)
+             */
+            double error;
+            
+            /**
+             * @brief Processing time of the per-sample update (microseconds per input sample)
+             */
+            double time;
+            
+            /**
+             * @brief Modeled number of multiplications per input sample (see Filterbank::multipliesPerSample)
+             */
+            double multiplies;
+            
+            /**
+             * @brief Largest delay of the bands (samples)
+             */
+            int latency;
+            
+            /**
+             * @brief Defines if the configuration meets the error tolerance and the CPU budget
+             */
+            bool feasible;
+        };
+        
+#pragma mark -
+#pragma mark === Public Interface ===
+#pragma mark > Constructors
+        /** @name Constructors */
+        ///@{
+        
+        /**
+         * @brief Constructor
+         * @details The candidates default to all optimisation modes, delays of 1, 1.5 and 2,
+         * paddings of 0 and 1, and the given number of bands per octave. There is no CPU budget,
+         * and the error tolerance is -20 dB.
+         * @param samplerate sampling rate of the data
+         * @param frequency_min minimum frequency of the filterbank (Hz)
+         * @param frequency_max maximum frequency of the filterbank (Hz)
+         * @param bands_per_octave number of bands per octave of the filterbank
+         */
+        Tuner(float samplerate,
+              float frequency_min,
+              float frequency_max,
+              float bands_per_octave);
+        
+        ///@}
+        
+#pragma mark > Tuning
+        /** @name Tuning */
+        ///@{
+        
+        /**
+         * @brief evaluate all candidate configurations and select the fastest feasible one
+         * @param values test signal (if empty, the synthetic signal is used)
+         * @return fastest configuration that meets the tolerance and the budget
+         * @throws domain_error if the tolerance is positive, the budget negative, or a candidate list empty
+         * @throws runtime_error if no candidate configuration is feasible (the results remain available in candidates())
+         */
+        Candidate tune(std::vector<float> const& values = std::vector<float>());
+        
+        /**
+         * @brief apply a configuration to a filterbank
+         * @details the frequency range of the filterbank is not modified
+         * @param filterbank filterbank
+         * @param candidate configuration (e.g. returned by tune())
+         */
+        static void configure(Filterbank& filterbank, Candidate const& candidate);
+        
+        /**
+         * @brief get the results of the last tuning
+         * @return evaluated configurations, in evaluation order
+         */
+        std::vector<Candidate> const& candidates() const;
+        
+        /**
+         * @brief generate the synthetic test signal
+         * @details logarithmic sweep over the frequency range, a sparse impulse train and
+         * white noise (fixed seed), long enough to cover the longest kernel several times
+         * @return synthetic signal
+         */
+        std::vector<float> syntheticSignal() const;
+        
+        /**
+         * @brief get the results of the last tuning as a table
+         * @return information string
+         */
+        std::string info() const;
+        
+        ///@}
+        
+#pragma mark -
+#pragma mark === Public Attributes ===
+        /**
+         * @brief Candidate optimisation modes
+         */
+        std::vector<Filterbank::Optimisation> optimisations;
+        
+        /**
+         * @brief Candidate delays (relative to critical wavelet time)
+         */
+        std::vector<float> delays;
+        
+        /**
+         * @brief Candidate paddings (relative to critical wavelet time)
+         */
+        std::vector<float> paddings;
+        
+        /**
+         * @brief Candidate numbers of bands per octave
+         * @details each configuration is compared with the reference at the same number of bands per octave,
+         * hence only resolutions that are acceptable for the application should be listed
+         */
+        std::vector<float> bands_per_octave;
+        
+        /**
+         * @brief Wavelet family
+         */
+        Family family;
+        
+        /**
+         * @brief Processing time budget (microseconds per input sample), 0 disables the constraint
+         */
+        double cpu_budget;
+        
+        /**
+         * @brief Maximum relative error of the magnitudes against the reference (dB)
+         */
+        double tolerance;
+        
+        ///@cond DEVDOC
+#ifndef WAVELET_TESTING
+    protected:
+#endif
+#pragma mark -
+#pragma mark === Protected Methods ===
+        /**
+         * @brief create a filterbank with a configuration of the tuner
+         * @param candidate configuration
+         * @return configured filterbank
+         */
+        std::unique_ptr<Filterbank> filterbank(Candidate const& candidate) const;
+        
+#pragma mark -
+#pragma mark === Protected Attributes ===
+        /**
+         * @brief Sampling rate of the data
+         */
+        float samplerate_;
+        
+        /**
+         * @brief Minimum frequency of the filterbank (Hz)
+         */
+        float frequency_min_;
+        
+        /**
+         * @brief Maximum frequency of the filterbank (Hz)
+         */
+        float frequency_max_;
+        
+        /**
+         * @brief Results of the last tuning
+         */
+        std::vector<Candidate> candidates_;
+        
+        ///@endcond
+    };
+}
+
+#endif
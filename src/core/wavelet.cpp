@@ -31,6 +31,29 @@
  */
 
 #include "wavelet.hpp"
+#include <algorithm>
+
+namespace {
+    /**
+     * @brief Padding sums shorter than this length are computed directly
+     */
+    const std::size_t padding_direct_length = 64;
+    
+    /**
+     * @brief Maximum width of the quadrature panels (in units of the wavelet argument)
+     */
+    const double integration_panel_width = 0.125;
+    
+    /**
+     * @brief Maximum width of the quadrature panels relative to the oscillation period of the wavelet
+     */
+    const double integration_panel_periods = 0.25;
+    
+    /**
+     * @brief Maximum relative truncation error of the Gregory summation formula (padding sums)
+     */
+    const double gregory_tolerance = 1e-10;
+}
 
 wavelet::Wavelet::Wavelet(float samplerate) :
 samplerate(this, samplerate, 0.),
@@ -68,29 +91,25 @@ void wavelet::Wavelet::_copy(Wavelet *dst, Wavelet const& src)
     dst->padding = src.padding;
     dst->padding.set_parent(dst);
     dst->values = src.values;
+    dst->kernel_cache_ = src.kernel_cache_;
 }
 
 void wavelet::Wavelet::init()
 {
+    std::vector<double> kernel_parameters;
+    if (kernel_cache_) {
+        kernel_parameters = kernelParameters();
+        if (kernel_cache_->load(kernel_parameters, values, prepad_value_, postpad_value_))
+            return;
+    }
     values.assign(this->window_size.get(), 0.0);
     if (this->mode.get() == RECURSIVE) {
         int pad_length = static_cast<int>(padding.get() * eFoldingTime() * this->samplerate.get());
-        prepad_value_ = std::complex<double>(0., 0.);
-        for (int t=-pad_length; t<0; ++t) {
-            double wavelet_arg = (double(t) - double(this->window_size.get() / 2)) / (this->scale.get() * this->samplerate.get());
-            prepad_value_ += std::conj(phi(wavelet_arg));
-        }
-        postpad_value_ = std::complex<double>(0., 0.);
-        for (int t = static_cast<int>(this->window_size.get());
-             t < static_cast<int>(this->window_size.get()) + pad_length;
-             ++t) {
-            double wavelet_arg = (double(t) - double(this->window_size.get() / 2)) / (this->scale.get() * this->samplerate.get());
-            postpad_value_ += std::conj(phi(wavelet_arg));
-        }
-        for (unsigned int t=0; t<this->window_size.get(); ++t) {
-            double wavelet_arg = (double(t) - double(this->window_size.get() / 2)) / (this->scale.get() * this->samplerate.get());
-            values[t] = phi(wavelet_arg);
-        }
+        double center = double(this->window_size.get() / 2);
+        double width = this->scale.get() * this->samplerate.get();
+        prepad_value_ = std::conj(phi_sum(-pad_length, pad_length, center, width));
+        postpad_value_ = std::conj(phi_sum(static_cast<int>(this->window_size.get()), pad_length, center, width));
+        phi_sequence(0, this->window_size.get(), center, width, values.data());
     } else { // mode_ == SPECTRAL
         values.assign(this->window_size.get(), std::complex<double>(0.0, 0.0));
         for (int t=0; t<int(this->window_size.get()/2); ++t) {
@@ -101,7 +120,11 @@ void wavelet::Wavelet::init()
             double s_omega = this->scale.get() * 2. * M_PI * t * this->samplerate.get() / double(this->window_size.get());
             values[t] = phi_spectral(-s_omega);
         }
+        prepad_value_ = std::complex<double>(0., 0.);
+        postpad_value_ = std::complex<double>(0., 0.);
     }
+    if (kernel_cache_)
+        kernel_cache_->store(kernel_parameters, values, prepad_value_, postpad_value_);
 }
 
 void wavelet::Wavelet::onAttributeChange(AttributeBase* attr_pointer)
@@ -121,51 +144,142 @@ std::string wavelet::Wavelet::info() const
     return infostrstream.str();
 }
 
-void wavelet::Wavelet::setAttribute_internal(std::string attr_name,
-                                              boost::any const& attr_value)
-{
-    if (attr_name == "samplerate") {
-        samplerate.set(boost::any_cast<float>(attr_value));
-    } else if (attr_name == "scale") {
-        scale.set(boost::any_cast<double>(attr_value));
-    } else if (attr_name == "window_size") {
-        window_size.set(boost::any_cast<std::size_t>(attr_value));
-    } else if (attr_name == "mode") {
-        mode.set(boost::any_cast<WaveletDomain>(attr_value));
-    } else if (attr_name == "delay") {
-        delay.set(boost::any_cast<float>(attr_value));
-    } else if (attr_name == "padding") {
-        padding.set(boost::any_cast<float>(attr_value));
-    } else {
-        throw std::out_of_range("Unknown attribute name");
+wavelet::AttributeBase* wavelet::Wavelet::attribute(AttributeId attr_id)
+{
+    switch (attr_id) {
+        case ATTR_SAMPLERATE:
+            return &samplerate;
+        case ATTR_SCALE:
+            return &scale;
+        case ATTR_WINDOW_SIZE:
+            return &window_size;
+        case ATTR_MODE:
+            return &mode;
+        case ATTR_DELAY:
+            return &delay;
+        case ATTR_PADDING:
+            return &padding;
+        default:
+            return nullptr;
+    }
+}
+
+void wavelet::Wavelet::phi_sequence(int first,
+                                    std::size_t length,
+                                    double center,
+                                    double width,
+                                    std::complex<double>* values) const
+{
+    for (std::size_t k=0; k<length; ++k) {
+        values[k] = phi((double(first + static_cast<int>(k)) - center) / width);
+    }
+}
+
+std::complex<double> wavelet::Wavelet::phi_integral(double arg_begin, double arg_end) const
+{
+    // Composite 8-point Gauss-Legendre quadrature, with panels narrower than a fraction of the
+    // oscillation period, 1 / (scale * frequency) in units of the wavelet argument
+    static const double nodes[4] = {0.1834346424956498, 0.5255324099163290, 0.7966664774136267, 0.9602898564975363};
+    static const double weights[4] = {0.3626837833783620, 0.3137066458778873, 0.2223810344533745, 0.1012285362903763};
+    double period = 1. / (this->scale.get() * scale2frequency(this->scale.get()));
+    double panel_width = std::min(integration_panel_width, integration_panel_periods * period);
+    std::size_t num_panels = static_cast<std::size_t>(std::ceil(std::abs(arg_end - arg_begin) / panel_width));
+    num_panels = (num_panels < 1) ? 1 : num_panels;
+    double half_width = 0.5 * (arg_end - arg_begin) / double(num_panels);
+    std::complex<double> integral(0., 0.);
+    for (std::size_t panel=0; panel<num_panels; ++panel) {
+        double panel_center = arg_begin + (2. * double(panel) + 1.) * half_width;
+        for (unsigned int i=0; i<4; ++i) {
+            integral += weights[i] * (phi(panel_center - half_width * nodes[i]) + phi(panel_center + half_width * nodes[i]));
+        }
     }
+    return integral * half_width;
 }
 
-boost::any wavelet::Wavelet::getAttribute_internal(std::string attr_name) const
-{
-    if (attr_name == "samplerate") {
-        return boost::any(samplerate.get());
-    } else if (attr_name == "scale") {
-        return boost::any(scale.get());
-    } else if (attr_name == "window_size") {
-        return boost::any(window_size.get());
-    } else if (attr_name == "mode") {
-        return boost::any(mode.get());
-    } else if (attr_name == "delay") {
-        return boost::any(delay.get());
-    } else if (attr_name == "padding") {
-        return boost::any(padding.get());
-    } else {
-        throw std::out_of_range("Unknown attribute name");
+wavelet::Wavelet::KernelSymmetry wavelet::Wavelet::symmetry() const
+{
+    return ASYMMETRIC;
+}
+
+std::complex<double> wavelet::Wavelet::phi_sum(int first,
+                                               std::size_t length,
+                                               double center,
+                                               double width) const
+{
+    std::complex<double> sum(0., 0.);
+    if (length < padding_direct_length) {
+        std::vector< std::complex<double> > values(length);
+        phi_sequence(first, length, center, width, values.data());
+        for (std::size_t k=0; k<length; ++k) {
+            sum += values[k];
+        }
+        return sum;
+    }
+    // Gregory summation formula: sum = integral + (f_0 + f_n) / 2 + sum_k g_k (backward_diff^k f_n + (-1)^k forward_diff^k f_0)
+    static const double gregory_coefficients[6] = {1. / 12., 1. / 24., 19. / 720., 3. / 160., 863. / 60480., 275. / 24192.};
+    const std::size_t num_samples = 7;
+    std::complex<double> head[num_samples];
+    std::complex<double> tail[num_samples];
+    int last = first + static_cast<int>(length) - 1;
+    phi_sequence(first, num_samples, center, width, head);
+    phi_sequence(last - static_cast<int>(num_samples) + 1, num_samples, center, width, tail);
+    std::reverse(tail, tail + num_samples); // tail[j] = f_(n-j)
+    sum = width * phi_integral((double(first) - center) / width, (double(last) - center) / width);
+    sum += 0.5 * (head[0] + tail[0]);
+    std::complex<double> correction(0., 0.);
+    // differences computed in place: after step k, head[0] = forward_diff^k f_0 and tail[0] = backward_diff^k f_n
+    for (std::size_t k=1; k<num_samples; ++k) {
+        for (std::size_t j=0; j<num_samples-k; ++j) {
+            head[j] = head[j+1] - head[j];
+            tail[j] = tail[j] - tail[j+1];
+        }
+        double sign = (k % 2 == 0) ? 1. : -1.;
+        correction = gregory_coefficients[k-1] * (tail[0] + sign * head[0]);
+        sum += correction;
+    }
+    // The last correction bounds the truncation error of the formula: it is large when the
+    // wavelet oscillates fast relative to the sampling, the sum is then computed directly
+    if (std::abs(correction) > gregory_tolerance * std::abs(sum)) {
+        sum = std::complex<double>(0., 0.);
+        std::complex<double> values[padding_direct_length];
+        for (std::size_t block=0; block<length; block+=padding_direct_length) {
+            std::size_t block_length = std::min(padding_direct_length, length - block);
+            phi_sequence(first + static_cast<int>(block), block_length, center, width, values);
+            for (std::size_t k=0; k<block_length; ++k) {
+                sum += values[k];
+            }
+        }
     }
+    return sum;
+}
+
+std::vector<double> wavelet::Wavelet::kernelParameters() const
+{
+    std::vector<double> parameters;
+    parameters.push_back(this->samplerate.get());
+    parameters.push_back(this->scale.get());
+    parameters.push_back(static_cast<double>(this->window_size.get()));
+    parameters.push_back(static_cast<double>(this->mode.get()));
+    parameters.push_back(this->padding.get());
+    return parameters;
+}
+
+void wavelet::Wavelet::setKernelCache(std::shared_ptr<KernelCache> kernel_cache)
+{
+    kernel_cache_ = kernel_cache;
+}
+
+std::shared_ptr<wavelet::KernelCache> wavelet::Wavelet::getKernelCache() const
+{
+    return kernel_cache_;
 }
 
-void wavelet::Wavelet::setDefaultWindowsize()
+void wavelet::Wavelet::setDefaultWindowsize(bool silently)
 {
     std::size_t winsize = static_cast<std::size_t>(2. * delay.get() * eFoldingTime() * this->samplerate.get());
     winsize = (winsize < 3) ? 3 : winsize;
     winsize += (winsize % 2 == 0);
-    window_size.set(winsize);
+    window_size.set(winsize, silently);
 }
 
 template <>
@@ -34,7 +34,9 @@
 #define wavelet_h
 
 #include "attribute.hpp"
+#include "kernel_cache.hpp"
 #include <iostream>
+#include <memory>
 #include <string>
 #include <complex>
 #include <cmath>
@@ -65,6 +67,26 @@ namespace wavelet {
             SPECTRAL = 1
         };
         
+        /**
+         * @brief Symmetry of the wavelet function around its center
+         */
+        enum KernelSymmetry : unsigned char {
+            /**
+             * @brief no particular symmetry
+             */
+            ASYMMETRIC = 0,
+            
+            /**
+             * @brief phi(-t) = conj(phi(t)): even real part, odd imaginary part
+             */
+            HERMITIAN = 1,
+            
+            /**
+             * @brief phi(-t) = -conj(phi(t)): odd real part, even imaginary part
+             */
+            ANTIHERMITIAN = 2
+        };
+        
         /**
          * @brief Default ratio of the delay to the wavelet's critical time
          */
@@ -114,38 +136,29 @@ namespace wavelet {
         ///@{
         
         /**
-         * @brief set attribute value by name
-         * @param attr_name attribute name
-         * @param attr_value attribute value
+         * @brief set the window size to default value with respect to the delay
+         * @param silently if true, the kernel is not recomputed
          */
-        template <typename T>
-        void setAttribute(std::string attr_name,
-                           T attr_value)
-        {
-            setAttribute_internal(attr_name, boost::any(attr_value));
-        }
+        void setDefaultWindowsize(bool silently = false);
         
         /**
-         * @brief get attribute value by name
-         * @param attr_name attribute name
-         * @return attribute value
+         * @brief get info on the current configuration
+         * @return information string
          */
-        template <typename T>
-        T getAttribute(std::string attr_name) const
-        {
-            return boost::any_cast<T>(getAttribute_internal(attr_name));
-        }
+        virtual std::string info() const;
         
         /**
-         * @brief set the window size to default value with respect to the delay
+         * @brief set the on-disk cache consulted when the kernel is computed
+         * @details the current kernel is not recomputed
+         * @param kernel_cache kernel cache (nullptr to disable caching)
          */
-        void setDefaultWindowsize();
+        void setKernelCache(std::shared_ptr<KernelCache> kernel_cache);
         
         /**
-         * @brief get info on the current configuration
-         * @return information string
+         * @brief get the on-disk kernel cache
+         * @return kernel cache (nullptr if caching is disabled)
          */
-        virtual std::string info() const;
+        std::shared_ptr<KernelCache> getKernelCache() const;
         
 #ifdef SWIGPYTHON
         /**
@@ -196,6 +209,41 @@ namespace wavelet {
          */
         virtual std::complex<double> phi_spectral(double s_omega) const = 0;
         
+        /**
+         * @brief rescaled wavelet function on a regular grid
+         * @details computes values[k] = phi((first + k - center) / width) for 0 <= k < length.
+         * The default implementation calls phi() for each point, wavelet instances can
+         * override it with faster recurrences.
+         * @param first index of the first point
+         * @param length number of points
+         * @param center index of the wavelet center
+         * @param width number of points per unit of the wavelet argument (scale * samplerate)
+         * @param values output array (length values)
+         */
+        virtual void phi_sequence(int first,
+                                  std::size_t length,
+                                  double center,
+                                  double width,
+                                  std::complex<double>* values) const;
+        
+        /**
+         * @brief integral of the rescaled wavelet function
+         * @details The default implementation uses a composite Gauss-Legendre quadrature whose
+         * panels span at most a quarter of the oscillation period at the wavelet's center frequency,
+         * wavelet instances can override it with closed forms.
+         * @param arg_begin lower bound of the wavelet argument
+         * @param arg_end upper bound of the wavelet argument
+         * @return integral of phi between arg_begin and arg_end
+         */
+        virtual std::complex<double> phi_integral(double arg_begin, double arg_end) const;
+        
+        /**
+         * @brief symmetry of the wavelet function around its center
+         * @details used by the filterbank to store only half of the kernel.
+         * The default implementation makes no assumption.
+         */
+        virtual KernelSymmetry symmetry() const;
+        
         ///@}
         
 #pragma mark -
@@ -261,24 +309,43 @@ namespace wavelet {
         virtual void onAttributeChange(AttributeBase* attr_pointer);
         
         /**
-         * @brief set attribute value by name
-         * @param attr_name attribute name
-         * @param attr_value attribute value
-         * @throws out_of_range if the attribute does not exist
+         * @brief get a pointer to an attribute by identifier
+         * @param attr_id attribute identifier
+         * @return pointer to the attribute, or nullptr if the attribute does not exist
          */
-        virtual void setAttribute_internal(std::string attr_name,
-                                            boost::any const& attr_value);
+        virtual AttributeBase* attribute(AttributeId attr_id);
         
         /**
-         * @brief get attribute value by name
-         * @param attr_name attribute name
-         * @throws out_of_range if the attribute does not exist
-         * @return attribute value
+         * @brief get the parameters that fully determine the kernel (used as kernel cache key)
+         * @details method to be extended in wavelet instances with the family-specific parameters
+         * @return kernel parameters
          */
-        virtual boost::any getAttribute_internal(std::string attr_name) const;
+        virtual std::vector<double> kernelParameters() const;
+        
+        /**
+         * @brief sum of the rescaled wavelet function on a regular grid (used for padding)
+         * @details Short sums are computed directly. Long sums are computed in constant time with the
+         * Gregory summation formula: integral of phi, plus corrections from the differences of the
+         * values at both ends of the grid. If the last correction shows that the formula has not
+         * converged (wavelet oscillating fast relative to the sampling), the sum is computed directly.
+         * @param first index of the first point
+         * @param length number of points
+         * @param center index of the wavelet center
+         * @param width number of points per unit of the wavelet argument (scale * samplerate)
+         * @return sum of phi((first + k - center) / width) for 0 <= k < length
+         */
+        std::complex<double> phi_sum(int first,
+                                     std::size_t length,
+                                     double center,
+                                     double width) const;
         
 #pragma mark -
 #pragma mark === Protected Attributes ===
+        /**
+         * @brief on-disk kernel cache (optional)
+         */
+        std::shared_ptr<KernelCache> kernel_cache_;
+        
         /**
          * @brief conjugate value for pre-padding of the wavelet
          */
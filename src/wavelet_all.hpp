@@ -32,6 +32,7 @@
 #define wavelet_all_h
 
 #include "core/filterbank.hpp"
+#include "core/tuner.hpp"
 
 /**
     @mainpage Wavelet - A library for online estimation of the Continuous Wavelet Transform
@@ -31,8 +31,16 @@
  */
 
 #include "morlet.hpp"
+#include <algorithm>
 #include <sstream>
 
+namespace {
+    /**
+     * @brief Number of points computed by recurrence between two direct evaluations
+     */
+    const std::size_t resync_period = 32;
+}
+
 wavelet::MorletWavelet::MorletWavelet(float samplerate)
 : Wavelet(samplerate),
 omega0(this, DEFAULT_OMEGA0(), 0.)
@@ -83,6 +91,40 @@ std::complex<double> wavelet::MorletWavelet::phi_spectral(double s_omega) const
     }
 }
 
+void wavelet::MorletWavelet::phi_sequence(int first,
+                                          std::size_t length,
+                                          double center,
+                                          double width,
+                                          std::complex<double>* values) const
+{
+    // phi(x) = norm * exp(-x^2 / 2) * (exp(i omega0 x) - exp(-omega0^2 / 2)) with x_k = x_0 + k dx:
+    // gaussian(x_k+1) = gaussian(x_k) * ratio_k, with ratio_k = exp(-x_k dx - dx^2 / 2) and ratio_k+1 = ratio_k * exp(-dx^2)
+    // phase(x_k+1) = phase(x_k) * exp(i omega0 dx)
+    double normalization = sqrt(1. / double(this->scale.get() * this->samplerate.get())) * pow(M_PI, -0.25);
+    double correction = std::exp(-0.5 * this->omega0.get() * this->omega0.get());
+    double dx = 1. / width;
+    double gaussian_ratio_step = std::exp(-dx * dx);
+    std::complex<double> phase_step = std::polar(1., this->omega0.get() * dx);
+    for (std::size_t k_start=0; k_start<length; k_start+=resync_period) {
+        double x = (double(first + static_cast<int>(k_start)) - center) / width;
+        double gaussian = normalization * std::exp(-0.5 * x * x);
+        double gaussian_ratio = std::exp(-x * dx - 0.5 * dx * dx);
+        std::complex<double> phase = std::polar(1., this->omega0.get() * x);
+        std::size_t k_end = std::min(length, k_start + resync_period);
+        for (std::size_t k=k_start; k<k_end; ++k) {
+            values[k] = gaussian * (phase - correction);
+            gaussian *= gaussian_ratio;
+            gaussian_ratio *= gaussian_ratio_step;
+            phase *= phase_step;
+        }
+    }
+}
+
+wavelet::Wavelet::KernelSymmetry wavelet::MorletWavelet::symmetry() const
+{
+    return HERMITIAN;
+}
+
 double wavelet::MorletWavelet::scale2frequency(double scale) const
 {
     return (this->omega0.get() + sqrt(2. + this->omega0.get()*this->omega0.get())) / (4. * M_PI * scale);
@@ -107,29 +149,17 @@ double wavelet::MorletWavelet::eFoldingTime() const
     return M_SQRT2 * this->scale.get();
 }
 
-void wavelet::MorletWavelet::setAttribute_internal(std::string attr_name,
-                                                    boost::any const& attr_value)
+wavelet::AttributeBase* wavelet::MorletWavelet::attribute(AttributeId attr_id)
 {
-    try {
-        Wavelet::setAttribute_internal(attr_name, attr_value);
-    } catch (std::out_of_range& e) {
-        if (attr_name == "omega0") {
-            omega0.set(boost::any_cast<float>(attr_value));
-        } else {
-            throw std::out_of_range(e);
-        }
-    }
+    if (attr_id == ATTR_OMEGA0)
+        return &omega0;
+    return Wavelet::attribute(attr_id);
 }
 
-boost::any wavelet::MorletWavelet::getAttribute_internal(std::string attr_name) const
+std::vector<double> wavelet::MorletWavelet::kernelParameters() const
 {
-    try {
-        return Wavelet::getAttribute_internal(attr_name);
-    } catch (std::out_of_range& e) {
-        if (attr_name == "omega0") {
-            return boost::any(omega0.get());
-        } else {
-            throw std::out_of_range(e);
-        }
-    }
+    std::vector<double> parameters = Wavelet::kernelParameters();
+    parameters.push_back(0.); // family identifier
+    parameters.push_back(this->omega0.get());
+    return parameters;
 }
@@ -130,6 +130,27 @@ namespace wavelet {
          */
         virtual std::complex<double> phi_spectral(double s_omega) const;
         
+        /**
+         * @brief rescaled wavelet function on a regular grid
+         * @details uses recurrences on the gaussian envelope and on the phase rotation,
+         * resynchronized periodically with a direct evaluation to bound the rounding errors
+         * @param first index of the first point
+         * @param length number of points
+         * @param center index of the wavelet center
+         * @param width number of points per unit of the wavelet argument (scale * samplerate)
+         * @param values output array (length values)
+         */
+        virtual void phi_sequence(int first,
+                                  std::size_t length,
+                                  double center,
+                                  double width,
+                                  std::complex<double>* values) const;
+        
+        /**
+         * @brief symmetry of the wavelet function around its center (Hermitian)
+         */
+        virtual KernelSymmetry symmetry() const;
+        
         ///@}
         
         
@@ -147,21 +168,17 @@ namespace wavelet {
 #pragma mark -
 #pragma mark === Protected Methods ===
         /**
-         * @brief set attribute value by name
-         * @param attr_name attribute name
-         * @param attr_value attribute value
-         * @throws out_of_range if the attribute does not exist
+         * @brief get a pointer to an attribute by identifier
+         * @param attr_id attribute identifier
+         * @return pointer to the attribute, or nullptr if the attribute does not exist
          */
-        virtual void setAttribute_internal(std::string attr_name,
-                                            boost::any const& attr_value);
+        virtual AttributeBase* attribute(AttributeId attr_id);
         
         /**
-         * @brief get attribute value by name
-         * @param attr_name attribute name
-         * @return attribute value
-         * @throws out_of_range if the attribute does not exist
+         * @brief get the parameters that fully determine the kernel (used as kernel cache key)
+         * @return kernel parameters
          */
-        virtual boost::any getAttribute_internal(std::string attr_name) const;
+        virtual std::vector<double> kernelParameters() const;
         
 #pragma mark -
 #pragma mark === Protected Attributes ===
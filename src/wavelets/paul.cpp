@@ -31,7 +31,109 @@
  */
 
 #include "paul.hpp"
+#include <algorithm>
+#include <cmath>
 #include <sstream>
+#include <vector>
+
+namespace {
+    /**
+     * @brief integer power of the imaginary unit
+     */
+    std::complex<double> imaginary_unit_power(unsigned int exponent)
+    {
+        switch (exponent % 4) {
+            case 0: return std::complex<double>(1., 0.);
+            case 1: return std::complex<double>(0., 1.);
+            case 2: return std::complex<double>(-1., 0.);
+            default: return std::complex<double>(0., -1.);
+        }
+    }
+    
+    /**
+     * @brief (1 - i.arg)^-exponent, by repeated squaring of 1 / (1 - i.arg) = (1 + i.arg) / (1 + arg^2)
+     * @details real arithmetic: avoids the complex division and the overflow checks of std::complex
+     */
+    std::complex<double> inverse_power(double arg, unsigned int exponent)
+    {
+        double inverse_modulus = 1. / (1. + arg * arg);
+        double base_real(inverse_modulus), base_imag(arg * inverse_modulus);
+        double result_real(1.), result_imag(0.);
+        while (exponent > 0) {
+            if (exponent & 1) {
+                double real = result_real * base_real - result_imag * base_imag;
+                result_imag = result_real * base_imag + result_imag * base_real;
+                result_real = real;
+            }
+            double real = base_real * base_real - base_imag * base_imag;
+            base_imag = 2. * base_real * base_imag;
+            base_real = real;
+            exponent >>= 1;
+        }
+        return std::complex<double>(result_real, result_imag);
+    }
+    
+    /**
+     * @brief constant * (1 - i.arg_k)^-exponent on the grid arg_k = (offset + k) / width
+     * @details blocks of points: the repeated squaring runs over each bit of the exponent for the
+     * whole block, so that the inner loops are branch-free and vectorized
+     */
+    void inverse_power_sequence(double offset,
+                                std::size_t length,
+                                double width,
+                                unsigned int exponent,
+                                std::complex<double> constant,
+                                std::complex<double>* values)
+    {
+        const std::size_t block_size = 64;
+        double base_real[block_size], base_imag[block_size];
+        double result_real[block_size], result_imag[block_size];
+        for (std::size_t block=0; block<length; block+=block_size) {
+            std::size_t block_length = std::min(block_size, length - block);
+            double block_offset = offset + double(block);
+            for (std::size_t k=0; k<block_length; ++k) {
+                double arg = (block_offset + double(static_cast<int>(k))) / width;
+                double inverse_modulus = 1. / (1. + arg * arg);
+                base_real[k] = inverse_modulus;
+                base_imag[k] = arg * inverse_modulus;
+                result_real[k] = constant.real();
+                result_imag[k] = constant.imag();
+            }
+            for (unsigned int remaining=exponent; remaining>0; remaining>>=1) {
+                if (remaining & 1) {
+                    for (std::size_t k=0; k<block_length; ++k) {
+                        double real = result_real[k] * base_real[k] - result_imag[k] * base_imag[k];
+                        result_imag[k] = result_real[k] * base_imag[k] + result_imag[k] * base_real[k];
+                        result_real[k] = real;
+                    }
+                }
+                if (remaining > 1) {
+                    for (std::size_t k=0; k<block_length; ++k) {
+                        double real = base_real[k] * base_real[k] - base_imag[k] * base_imag[k];
+                        base_imag[k] = 2. * base_real[k] * base_imag[k];
+                        base_real[k] = real;
+                    }
+                }
+            }
+            for (std::size_t k=0; k<block_length; ++k)
+                values[block + k] = std::complex<double>(result_real[k], result_imag[k]);
+        }
+    }
+    
+    /**
+     * @brief normalization of the wavelet function: 2^m m! / sqrt(pi (2m)!)
+     */
+    double normalization_constant(unsigned int order)
+    {
+        double m = double(order);
+        return std::exp(m * M_LN2 + std::lgamma(m + 1.) - 0.5 * (std::log(M_PI) + std::lgamma(2. * m + 1.)));
+    }
+    
+    /**
+     * @brief Number of orders whose normalization is tabulated
+     */
+    const unsigned int tabulated_orders = 64;
+}
 
 wavelet::PaulWavelet::PaulWavelet(float samplerate) :
 Wavelet(samplerate),
@@ -60,32 +162,71 @@ wavelet::PaulWavelet::~PaulWavelet()
 {
 }
 
-unsigned int wavelet::PaulWavelet::factorial(unsigned int n) const
+double wavelet::PaulWavelet::normalization() const
 {
-    unsigned int result(1);
-    for (unsigned int i=2; i<=n; i++) {
-        result *= i;
-    }
-    return result;
+    static const std::vector<double> table = [] {
+        std::vector<double> normalizations(tabulated_orders);
+        for (unsigned int m=0; m<tabulated_orders; m++)
+            normalizations[m] = normalization_constant(m);
+        return normalizations;
+    }();
+    return (order.get() < tabulated_orders) ? table[order.get()] : normalization_constant(order.get());
 }
 
 std::complex<double> wavelet::PaulWavelet::phi(double arg) const
 {
-    std::complex<double> numer = std::pow(2. * std::complex<double>(0, 1), order.get()) * double(factorial(order.get()));
-    std::complex<double> denum = std::sqrt(M_PI * factorial(2 * order.get()));
-    std::complex<double> second_arg = std::pow(std::complex<double>(1, -arg), -int(order.get() + 1));
-    return (numer / denum) * second_arg
+    return imaginary_unit_power(order.get()) * normalization()
+           * inverse_power(arg, order.get() + 1)
            * sqrt(1. / double(this->scale.get() * this->samplerate.get())); // normalization
 }
 
+void wavelet::PaulWavelet::phi_sequence(int first,
+                                        std::size_t length,
+                                        double center,
+                                        double width,
+                                        std::complex<double>* values) const
+{
+    std::complex<double> constant = imaginary_unit_power(order.get()) * normalization()
+                                    * sqrt(1. / double(this->scale.get() * this->samplerate.get()));
+    double offset = double(first) - center;
+    // Points k and j = mirror - k have opposite arguments: phi(-arg) = +/- conj(phi(arg))
+    double mirror = -2. * offset;
+    if (mirror < 0. || mirror != std::floor(mirror)) {
+        inverse_power_sequence(offset, length, width, order.get() + 1, constant, values);
+        return;
+    }
+    std::size_t mirror_index = static_cast<std::size_t>(mirror);
+    std::size_t head = std::min(length, mirror_index / 2 + 1);
+    std::size_t tail = std::min(length, std::max(head, mirror_index + 1));
+    inverse_power_sequence(offset, head, width, order.get() + 1, constant, values);
+    double sign = (symmetry() == HERMITIAN) ? 1. : -1.;
+    for (std::size_t k=head; k<tail; ++k)
+        values[k] = sign * std::conj(values[mirror_index - k]);
+    inverse_power_sequence(offset + double(tail), length - tail, width, order.get() + 1, constant, values + tail);
+}
+
+std::complex<double> wavelet::PaulWavelet::phi_integral(double arg_begin, double arg_end) const
+{
+    std::complex<double> constant = imaginary_unit_power(order.get()) * normalization()
+                                    * sqrt(1. / double(this->scale.get() * this->samplerate.get()))
+                                    / std::complex<double>(0., double(order.get()));
+    return constant * (inverse_power(arg_end, order.get()) - inverse_power(arg_begin, order.get()));
+}
+
+wavelet::Wavelet::KernelSymmetry wavelet::PaulWavelet::symmetry() const
+{
+    return (order.get() % 2 == 0) ? HERMITIAN : ANTIHERMITIAN;
+}
+
 std::complex<double> wavelet::PaulWavelet::phi_spectral(double s_omega) const
 {
     if (s_omega > 0) {
-        double numer = std::pow(2., order.get());
-        double denum = std::sqrt(order.get() * factorial(2 * order.get() - 1));
+        double m = double(order.get());
+        // 2^m / sqrt(m (2m-1)!)
+        double normalization_spectral = std::exp(m * M_LN2 - 0.5 * (std::log(m) + std::lgamma(2. * m)));
         double second_arg = std::pow(s_omega, order.get());
         double third_arg = std::exp(-s_omega);
-        return(numer / denum) * second_arg * third_arg;
+        return normalization_spectral * second_arg * third_arg;
     } else {
         return 0.;
     }
@@ -115,29 +256,17 @@ double wavelet::PaulWavelet::eFoldingTime() const
     return this->scale.get() / M_SQRT2;
 }
 
-void wavelet::PaulWavelet::setAttribute_internal(std::string attr_name,
-                                                    boost::any const& attr_value)
+wavelet::AttributeBase* wavelet::PaulWavelet::attribute(AttributeId attr_id)
 {
-    try {
-        Wavelet::setAttribute_internal(attr_name, attr_value);
-    } catch (std::out_of_range& e) {
-        if (attr_name == "order") {
-            order.set(boost::any_cast<float>(attr_value));
-        } else {
-            throw std::out_of_range(e);
-        }
-    }
+    if (attr_id == ATTR_ORDER)
+        return &order;
+    return Wavelet::attribute(attr_id);
 }
 
-boost::any wavelet::PaulWavelet::getAttribute_internal(std::string attr_name) const
+std::vector<double> wavelet::PaulWavelet::kernelParameters() const
 {
-    try {
-        return Wavelet::getAttribute_internal(attr_name);
-    } catch (std::out_of_range& e) {
-        if (attr_name == "order") {
-            return boost::any(order.get());
-        } else {
-            throw std::out_of_range(e);
-        }
-    }
+    std::vector<double> parameters = Wavelet::kernelParameters();
+    parameters.push_back(1.); // family identifier
+    parameters.push_back(this->order.get());
+    return parameters;
 }
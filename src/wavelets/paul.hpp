@@ -129,6 +129,39 @@ namespace wavelet {
          */
         virtual std::complex<double> phi_spectral(double s_omega) const;
         
+        /**
+         * @brief rescaled wavelet function on a regular grid
+         * @details the normalization is computed once, and the power of (1 - i.arg) is computed
+         * by repeated squaring in real arithmetic, over blocks of points. Points with opposite
+         * arguments are mirrored using the symmetry of the wavelet.
+         * @param first index of the first point
+         * @param length number of points
+         * @param center index of the wavelet center
+         * @param width number of points per unit of the wavelet argument (scale * samplerate)
+         * @param values output array (length values)
+         */
+        virtual void phi_sequence(int first,
+                                  std::size_t length,
+                                  double center,
+                                  double width,
+                                  std::complex<double>* values) const;
+        
+        /**
+         * @brief integral of the rescaled wavelet function
+         * @details closed form: the antiderivative of (1 - i.arg)^-(m+1) is (1 - i.arg)^-m / (i.m)
+         * @param arg_begin lower bound of the wavelet argument
+         * @param arg_end upper bound of the wavelet argument
+         * @return integral of phi between arg_begin and arg_end
+         */
+        virtual std::complex<double> phi_integral(double arg_begin, double arg_end) const;
+        
+        /**
+         * @brief symmetry of the wavelet function around its center
+         * @details (1 + i.arg)^-(m+1) is the conjugate of (1 - i.arg)^-(m+1), and the
+         * normalization contains i^m: Hermitian for even orders, anti-Hermitian for odd orders
+         */
+        virtual KernelSymmetry symmetry() const;
+        
         ///@}
         
         
@@ -146,23 +179,25 @@ namespace wavelet {
 #pragma mark -
 #pragma mark === Protected Methods ===
         /**
-         * @brief set attribute value by name
-         * @param attr_name attribute name
-         * @param attr_value attribute value
-         * @throws out_of_range if the attribute does not exist
+         * @brief get a pointer to an attribute by identifier
+         * @param attr_id attribute identifier
+         * @return pointer to the attribute, or nullptr if the attribute does not exist
          */
-        virtual void setAttribute_internal(std::string attr_name,
-                                            boost::any const& attr_value);
+        virtual AttributeBase* attribute(AttributeId attr_id);
         
         /**
-         * @brief get attribute value by name
-         * @param attr_name attribute name
-         * @return attribute value
-         * @throws out_of_range if the attribute does not exist
+         * @brief get the parameters that fully determine the kernel (used as kernel cache key)
+         * @return kernel parameters
          */
-        virtual boost::any getAttribute_internal(std::string attr_name) const;
+        virtual std::vector<double> kernelParameters() const;
         
-        unsigned int factorial(unsigned int n) const;
+        /**
+         * @brief normalization of the wavelet function: 2^m m! / sqrt(pi (2m)!)
+         * @details computed from log-gamma functions to avoid overflows for large orders,
+         * and tabulated for the usual orders (phi() is evaluated point by point)
+         * @return normalization constant
+         */
+        double normalization() const;
         
 #pragma mark -
 #pragma mark === Protected Attributes ===
@@ -34,6 +34,10 @@
 #include "catch_utilities.hpp"
 #define WAVELET_TESTING
 #include "wavelet_all.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <unistd.h>
 
 TEST_CASE( "Filterbank: Attributes", "[Filterbank]" )
 {
@@ -70,6 +74,1300 @@ TEST_CASE( "Filterbank: Attributes", "[Filterbank]" )
     CHECK(filterbank.getAttribute<float>("omega0") == 5.);
 }
 
+TEST_CASE( "Filterbank: Attribute identifiers", "[Filterbank]" )
+{
+    wavelet::Filterbank filterbank(100., 1., 30., 4);
+    CHECK(wavelet::attributeId("bands_per_octave") == wavelet::ATTR_BANDS_PER_OCTAVE);
+    CHECK(wavelet::attributeName(wavelet::ATTR_OMEGA0) == "omega0");
+    CHECK(wavelet::attributeId("foo") == wavelet::ATTR_UNKNOWN);
+    float value(0.);
+    CHECK(filterbank.getAttribute(wavelet::ATTR_FREQUENCY_MIN, value));
+    CHECK(value == 1.);
+    CHECK(filterbank.getAttribute(wavelet::ATTR_OMEGA0, value));
+    CHECK(value == 5.);
+    unsigned int order(0);
+    CHECK_FALSE(filterbank.getAttribute(wavelet::ATTR_ORDER, order));
+    std::size_t window_size(0);
+    CHECK_FALSE(filterbank.getAttribute(wavelet::ATTR_WINDOW_SIZE, window_size));
+    double wrong_type(0.);
+    CHECK_FALSE(filterbank.getAttribute(wavelet::ATTR_FREQUENCY_MAX, wrong_type));
+    CHECK_FALSE(filterbank.setAttribute(wavelet::ATTR_FREQUENCY_MAX, 20.));
+    CHECK_FALSE(filterbank.setAttribute(wavelet::ATTR_FREQUENCY_MIN, 40.f));
+    CHECK(filterbank.getAttribute<float>("frequency_min") == 1.);
+    CHECK(filterbank.setAttribute(wavelet::ATTR_BANDS_PER_OCTAVE, 8.f));
+    CHECK(filterbank.size() == wavelet::Filterbank(100., 1., 30., 8).size());
+    CHECK(filterbank.setAttribute(wavelet::ATTR_OMEGA0, 6.f));
+    CHECK(filterbank.wavelets_[0]->getAttribute<float>("omega0") == 6.);
+    CHECK(filterbank.setAttribute(wavelet::ATTR_FAMILY, wavelet::PAUL));
+    CHECK(filterbank.setAttribute(wavelet::ATTR_ORDER, 4u));
+    CHECK(filterbank.getAttribute<unsigned int>("order") == 4);
+    CHECK(filterbank.wavelets_[0]->getAttribute<unsigned int>("order") == 4);
+    filterbank.setAttribute("order", 2.f);
+    CHECK(filterbank.getAttribute<unsigned int>("order") == 2);
+    CHECK(filterbank.setAttribute(wavelet::ATTR_ORDER, 3.f));
+    CHECK(filterbank.wavelets_[0]->getAttribute<unsigned int>("order") == 3);
+    CHECK_FALSE(filterbank.setAttribute(wavelet::ATTR_ORDER, -1.f));
+    CHECK_THROWS_AS(filterbank.setAttribute("order", 0.f), std::domain_error);
+    CHECK_THROWS(filterbank.getAttribute<float>("omega0"));
+}
+
+TEST_CASE( "Filterbank: Configuration transactions", "[Filterbank]" )
+{
+    float samplerate(100.);
+    wavelet::Filterbank filterbank(samplerate, 1., 10., 4);
+    filterbank.beginConfig();
+    filterbank.setAttribute<float>("frequency_min", 20.);
+    filterbank.setAttribute<float>("frequency_max", 40.);
+    filterbank.setAttribute<float>("bands_per_octave", 8.);
+    filterbank.setAttribute<float>("omega0", 6.);
+    CHECK(filterbank.size() == 13);
+    filterbank.commitConfig();
+    wavelet::Filterbank reference(samplerate, 20., 40., 8);
+    reference.setAttribute<float>("omega0", 6.);
+    REQUIRE(filterbank.size() == reference.size());
+    for (unsigned int i=0; i<filterbank.size(); i++) {
+        CHECK(filterbank.scales[i] == Approx(reference.scales[i]));
+    }
+    CHECK_THROWS(filterbank.setAttribute<float>("frequency_min", 45.));
+    filterbank.beginConfig();
+    filterbank.setAttribute<float>("frequency_min", 45.);
+    CHECK_THROWS(filterbank.commitConfig());
+    filterbank.setAttribute<float>("samplerate", 200.);
+    filterbank.setAttribute<float>("frequency_max", 80.);
+    filterbank.commitConfig();
+    CHECK(filterbank.getAttribute<float>("frequency_min") == 45.);
+    CHECK(filterbank.getAttribute<float>("frequency_max") == 80.);
+    CHECK_THROWS(filterbank.setAttribute<float>("frequency_max", 120.));
+}
+
+TEST_CASE( "Filterbank: Incremental reconfiguration", "[Filterbank]" )
+{
+    float samplerate(100.);
+    wavelet::Filterbank filterbank(samplerate, 2., 30., 4);
+    filterbank.optimisation.set(wavelet::Filterbank::STANDARD);
+    wavelet::Filterbank reference(filterbank);
+    for (unsigned int t=0; t<500; t++) {
+        float value = sin(2 * M_PI * 5. * t / samplerate) + 0.3 * cos(2 * M_PI * 17. * t / samplerate);
+        filterbank.update(value);
+        reference.update(value);
+    }
+    
+    // Removing high-frequency bands keeps the history of the remaining stages
+    filterbank.frequency_max.set(20.);
+    std::size_t offset = reference.size() - filterbank.size();
+    REQUIRE(offset > 0);
+    CHECK(filterbank.frame_index_ == reference.frame_index_);
+    for (unsigned int i=0; i<filterbank.size(); i++) {
+        CHECK(filterbank.scales[i] == reference.scales[i + offset]);
+        CHECK(filterbank.result_power[i] == reference.result_power[i + offset]);
+    }
+    for (unsigned int t=500; t<700; t++) {
+        float value = sin(2 * M_PI * 5. * t / samplerate) + 0.3 * cos(2 * M_PI * 17. * t / samplerate);
+        filterbank.update(value);
+        reference.update(value);
+        for (unsigned int i=0; i<filterbank.size(); i++) {
+            CHECK(filterbank.result_complex[i].real() == Approx(reference.result_complex[i + offset].real()));
+            CHECK(filterbank.result_complex[i].imag() == Approx(reference.result_complex[i + offset].imag()));
+        }
+    }
+    
+    // Adding low-frequency bands only allocates the new bands and stages
+    std::size_t previous_size = filterbank.size();
+    int previous_max_factor = filterbank.downsampling_factors.back();
+    std::shared_ptr<wavelet::Wavelet> first_wavelet = filterbank.wavelets_[0];
+    filterbank.frequency_min.set(1.);
+    REQUIRE(filterbank.size() > previous_size);
+    CHECK(filterbank.wavelets_[0] == first_wavelet);
+    for (unsigned int t=700; t<900; t++) {
+        float value = sin(2 * M_PI * 5. * t / samplerate) + 0.3 * cos(2 * M_PI * 17. * t / samplerate);
+        filterbank.update(value);
+        reference.update(value);
+        for (unsigned int i=0; i<previous_size; i++) {
+            if (filterbank.downsampling_factors[i] == previous_max_factor) break;
+            CHECK(filterbank.result_complex[i].real() == Approx(reference.result_complex[i + offset].real()));
+            CHECK(filterbank.result_complex[i].imag() == Approx(reference.result_complex[i + offset].imag()));
+        }
+    }
+    
+    // Changing the wavelet parameters requires a complete initialization
+    filterbank.setAttribute<float>("omega0", 6.);
+    CHECK(filterbank.frame_index_ == 0);
+}
+
+TEST_CASE( "Filterbank: Snapshots", "[Filterbank]" )
+{
+    float samplerate(100.);
+    std::string filename("wavelet_snapshot_test.bin");
+    wavelet::Filterbank filterbank(samplerate, 1., 30., 4);
+    filterbank.beginConfig();
+    filterbank.family.set(wavelet::PAUL);
+    filterbank.optimisation.set(wavelet::Filterbank::STANDARD);
+    filterbank.setAttribute<unsigned int>("order", 4);
+    filterbank.decimation.set(wavelet::Filterbank::POW2);
+    filterbank.commitConfig();
+    filterbank.save(filename);
+    
+    wavelet::Filterbank loaded(samplerate * 2, 2., 20., 8);
+    loaded.load(filename);
+    std::remove(filename.c_str());
+    CHECK(loaded.family.get() == wavelet::PAUL);
+    CHECK(loaded.optimisation.get() == wavelet::Filterbank::STANDARD);
+    CHECK(loaded.decimation.get() == wavelet::Filterbank::POW2);
+    CHECK(loaded.getAttribute<unsigned int>("order") == 4);
+    CHECK(loaded.getAttribute<float>("samplerate") == samplerate);
+    CHECK(loaded.getAttribute<float>("frequency_min") == 1.);
+    CHECK(loaded.getAttribute<float>("frequency_max") == 30.);
+    REQUIRE(loaded.size() == filterbank.size());
+    CHECK(loaded.downsampling_factors == filterbank.downsampling_factors);
+    for (unsigned int i=0; i<filterbank.size(); i++) {
+        CHECK(loaded.scales[i] == filterbank.scales[i]);
+        CHECK(loaded.frequencies[i] == Approx(filterbank.frequencies[i]));
+        CHECK(loaded.wavelets_[i]->values == filterbank.wavelets_[i]->values);
+        CHECK(loaded.wavelets_[i]->prepad_value_ == filterbank.wavelets_[i]->prepad_value_);
+        CHECK(loaded.wavelets_[i]->postpad_value_ == filterbank.wavelets_[i]->postpad_value_);
+    }
+    for (unsigned int t=0; t<300; t++) {
+        float value = sin(2 * M_PI * 5. * t / samplerate);
+        filterbank.update(value);
+        loaded.update(value);
+    }
+    for (unsigned int i=0; i<filterbank.size(); i++) {
+        CHECK(loaded.result_complex[i] == filterbank.result_complex[i]);
+    }
+    
+    // Changing an attribute after loading reinitializes the filterbank as usual
+    loaded.frequency_min.set(2.);
+    wavelet::Filterbank reference(filterbank);
+    reference.frequency_min.set(2.);
+    CHECK(loaded.size() == reference.size());
+    
+    std::ofstream invalid(filename.c_str(), std::ios::binary);
+    invalid << "NOT A SNAPSHOT";
+    invalid.close();
+    CHECK_THROWS(loaded.load(filename));
+    std::remove(filename.c_str());
+    CHECK_THROWS(loaded.load(filename));
+    CHECK(loaded.size() == reference.size());
+}
+
+TEST_CASE( "Filterbank: Streaming state", "[Filterbank]" )
+{
+    float samplerate(100.);
+    wavelet::Filterbank filterbank(samplerate, 1., 30., 4);
+    filterbank.optimisation.set(wavelet::Filterbank::AGRESSIVE);
+    for (unsigned int t=0; t<401; t++) {
+        filterbank.update(sin(2 * M_PI * 5. * t / samplerate) + 0.1 * t / samplerate);
+    }
+    std::vector<char> state = filterbank.saveState();
+    
+    wavelet::Filterbank restored(samplerate, 1., 30., 4);
+    restored.optimisation.set(wavelet::Filterbank::AGRESSIVE);
+    restored.restoreState(state);
+    CHECK(restored.frame_index_ == filterbank.frame_index_);
+    for (unsigned int i=0; i<filterbank.size(); i++) {
+        CHECK(restored.result_complex[i] == filterbank.result_complex[i]);
+        CHECK(restored.result_power[i] == filterbank.result_power[i]);
+    }
+    for (unsigned int t=401; t<600; t++) {
+        float value = sin(2 * M_PI * 5. * t / samplerate) + 0.1 * t / samplerate;
+        filterbank.update(value);
+        restored.update(value);
+        for (unsigned int i=0; i<filterbank.size(); i++) {
+            CHECK(restored.result_complex[i] == filterbank.result_complex[i]);
+        }
+    }
+    
+    wavelet::Filterbank other(samplerate, 1., 30., 4);
+    CHECK_THROWS(other.restoreState(state));
+    std::vector<char> truncated(state.begin(), state.begin() + state.size() / 2);
+    CHECK_THROWS(restored.restoreState(truncated));
+    CHECK(restored.frame_index_ == filterbank.frame_index_);
+}
+
+TEST_CASE( "Filterbank: Kernel cache", "[Filterbank]" )
+{
+    char directory[] = "wavelet_kernel_cache_XXXXXX";
+    REQUIRE(mkdtemp(directory) != nullptr);
+    std::shared_ptr<wavelet::KernelCache> kernel_cache(new wavelet::KernelCache(directory));
+    float samplerate(100.);
+    wavelet::Filterbank reference(samplerate, 1., 10., 4);
+    reference.setAttribute<float>("omega0", 6.);
+    
+    wavelet::Filterbank filterbank(samplerate, 1., 10., 4);
+    filterbank.setKernelCache(kernel_cache);
+    filterbank.setAttribute<float>("omega0", 6.);
+    std::vector< std::complex<double> > values;
+    std::complex<double> prepad_value, postpad_value;
+    for (unsigned int i=0; i<filterbank.size(); i++) {
+        REQUIRE(kernel_cache->load(filterbank.wavelets_[i]->kernelParameters(), values, prepad_value, postpad_value));
+        CHECK(values == reference.wavelets_[i]->values);
+        CHECK(prepad_value == reference.wavelets_[i]->prepad_value_);
+        CHECK(postpad_value == reference.wavelets_[i]->postpad_value_);
+    }
+    
+    // Corrupted entries are detected and recomputed
+    std::string corrupted_path = kernel_cache->path(filterbank.wavelets_[0]->kernelParameters());
+    {
+        std::fstream corrupted(corrupted_path.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+        corrupted.seekp(64);
+        corrupted.put(0x2a);
+    }
+    CHECK_FALSE(kernel_cache->load(filterbank.wavelets_[0]->kernelParameters(), values, prepad_value, postpad_value));
+    wavelet::Filterbank cached(samplerate, 1., 10., 4);
+    cached.setKernelCache(kernel_cache);
+    cached.setAttribute<float>("omega0", 6.);
+    CHECK(cached.getKernelCache() == kernel_cache);
+    for (unsigned int i=0; i<cached.size(); i++) {
+        CHECK(cached.wavelets_[i]->values == reference.wavelets_[i]->values);
+        CHECK(cached.wavelets_[i]->prepad_value_ == reference.wavelets_[i]->prepad_value_);
+    }
+    CHECK(kernel_cache->load(filterbank.wavelets_[0]->kernelParameters(), values, prepad_value, postpad_value));
+    
+    for (unsigned int i=0; i<cached.size(); i++) {
+        std::remove(kernel_cache->path(cached.wavelets_[i]->kernelParameters()).c_str());
+    }
+    std::remove(kernel_cache->path(cached.reference_wavelet_->kernelParameters()).c_str());
+    CHECK(rmdir(directory) == 0);
+}
+
+TEST_CASE( "Filterbank: Parallel kernel generation", "[Filterbank]" )
+{
+    float samplerate(100.);
+    wavelet::Filterbank reference(samplerate, 0.5, 40., 8);
+    reference.optimisation.set(wavelet::Filterbank::STANDARD);
+    wavelet::Filterbank filterbank(samplerate, 0.5, 40., 8);
+    filterbank.setAttribute<unsigned int>("threads", 4);
+    CHECK(filterbank.getAttribute<unsigned int>("threads") == 4);
+    CHECK_THROWS(filterbank.setAttribute<unsigned int>("threads", 0));
+    filterbank.optimisation.set(wavelet::Filterbank::STANDARD);
+    REQUIRE(filterbank.size() == reference.size());
+    for (unsigned int i=0; i<filterbank.size(); i++) {
+        CHECK(filterbank.wavelets_[i]->window_size.get() == reference.wavelets_[i]->window_size.get());
+        CHECK(filterbank.wavelets_[i]->values == reference.wavelets_[i]->values);
+        CHECK(filterbank.wavelets_[i]->prepad_value_ == reference.wavelets_[i]->prepad_value_);
+        CHECK(filterbank.wavelets_[i]->postpad_value_ == reference.wavelets_[i]->postpad_value_);
+    }
+}
+
+TEST_CASE( "Filterbank: Kernel arena", "[Filterbank]" )
+{
+    float samplerate(100.);
+    wavelet::Filterbank filterbank(samplerate, 1., 30., 4);
+    filterbank.optimisation.set(wavelet::Filterbank::STANDARD);
+    REQUIRE(filterbank.bands_.size() == filterbank.size());
+    std::size_t arena_end(0);
+    for (unsigned int i=0; i<filterbank.size(); i++) {
+        wavelet::Filterbank::BandDescriptor const& band = filterbank.bands_[i];
+        const double* kernel = filterbank.kernel_arena_.data() + band.offset;
+        CHECK(reinterpret_cast<std::uintptr_t>(kernel) % 64 == 0);
+        CHECK(band.window_size == filterbank.wavelets_[i]->window_size.get());
+        CHECK(band.decimation == std::size_t(filterbank.downsampling_factors[i]));
+        CHECK(band.buffer == &filterbank.data_[filterbank.downsampling_factors[i]]);
+        if (i > 0)
+            CHECK(band.decimation >= filterbank.bands_[i-1].decimation);
+        // Kernels are packed in order, bands sharing a kernel point to the same copy
+        if (band.offset < arena_end) {
+            unsigned int source(0);
+            while (source < i && filterbank.bands_[source].offset != band.offset)
+                source++;
+            REQUIRE(source < i);
+            CHECK(filterbank.wavelets_[source]->values == filterbank.wavelets_[i]->values);
+        } else {
+            arena_end = band.offset + 2 * band.half_size;
+        }
+        // Morlet kernels are Hermitian: only the center and the right half are stored
+        REQUIRE(band.symmetry == wavelet::Wavelet::HERMITIAN);
+        CHECK(band.half_size == band.window_size / 2 + 1);
+        std::size_t center = band.half_size - 1;
+        for (unsigned int k=0; k<band.half_size; k++) {
+            CHECK(kernel[k] == Approx(filterbank.wavelets_[i]->values[center + k].real()));
+            if (k > 0)
+                CHECK(kernel[band.half_size + k] == Approx(-filterbank.wavelets_[i]->values[center + k].imag()));
+        }
+    }
+}
+
+TEST_CASE( "Filterbank: Stages", "[Filterbank]" )
+{
+    float samplerate(100.);
+    wavelet::Filterbank filterbank(samplerate, 1., 30., 4);
+    for (unsigned int optimisation=0; optimisation<5; optimisation++) {
+        filterbank.optimisation.set(wavelet::Filterbank::Optimisation(optimisation));
+        if (optimisation == wavelet::Filterbank::NONE || optimisation == wavelet::Filterbank::HETERODYNE) {
+            CHECK(filterbank.stages_.size() == 1);
+        } else if (optimisation == wavelet::Filterbank::ATROUS) {
+            // The cascade keeps every dyadic level, even without bands
+            CHECK(filterbank.stages_.size() <= filterbank.data_.size());
+            CHECK(filterbank.filters_.empty());
+        } else {
+            CHECK(filterbank.stages_.size() == filterbank.data_.size());
+        }
+        std::size_t next_band(0);
+        for (auto const& stage : filterbank.stages_) {
+            CHECK(stage.first_band == next_band);
+            REQUIRE(stage.num_bands > 0);
+            CHECK(stage.length * stage.stride <= stage.buffer->capacity());
+            CHECK(stage.length <= filterbank.stage_samples_.size());
+            for (std::size_t i=stage.first_band; i<stage.first_band+stage.num_bands; i++) {
+                CHECK(filterbank.bands_[i].decimation == stage.decimation);
+                CHECK(filterbank.bands_[i].buffer == stage.buffer);
+                CHECK(filterbank.bands_[i].first_sample + filterbank.bands_[i].lag / stage.stride == stage.length);
+            }
+            next_band += stage.num_bands;
+        }
+        CHECK(next_band == filterbank.size());
+    }
+}
+
+TEST_CASE( "Filterbank: Block update", "[Filterbank]" )
+{
+    float samplerate(100.);
+    std::vector<std::size_t> block_sizes = {1, 7, 40, 300, 3};
+    for (unsigned int optimisation=0; optimisation<5; optimisation++) {
+        wavelet::Filterbank reference(samplerate, 1., 30., 4);
+        reference.optimisation.set(wavelet::Filterbank::Optimisation(optimisation));
+        if (optimisation == wavelet::Filterbank::AGRESSIVE)
+            reference.family.set(wavelet::PAUL);
+        wavelet::Filterbank filterbank(reference);
+        double max_error(0.);
+        double max_value(0.);
+        unsigned int t(0);
+        for (auto block_size : block_sizes) {
+            std::vector<float> values(block_size);
+            for (auto &value : values) {
+                value = sin(2 * M_PI * 7. * t / samplerate) + 0.3 * float(t % 13) / 13.;
+                t++;
+            }
+            std::vector< std::complex<double> > scalogram;
+            filterbank.update(values, scalogram);
+            REQUIRE(scalogram.size() == block_size * filterbank.size());
+            for (std::size_t frame=0; frame<block_size; frame++) {
+                reference.update(values[frame]);
+                for (unsigned int i=0; i<reference.size(); i++) {
+                    max_error = std::max(max_error, std::abs(scalogram[frame * filterbank.size() + i] - reference.result_complex[i]));
+                    max_value = std::max(max_value, std::abs(reference.result_complex[i]));
+                }
+            }
+            for (unsigned int i=0; i<reference.size(); i++) {
+                CHECK(std::abs(filterbank.result_complex[i] - reference.result_complex[i]) <= 1e-9 * max_value);
+            }
+        }
+        CHECK(max_error < 1e-9 * max_value);
+        // The buffers are left in the same state
+        std::vector< std::complex<double> > scalogram;
+        filterbank.update(std::vector<float>(1, 0.5), scalogram);
+        reference.update(0.5);
+        for (unsigned int i=0; i<reference.size(); i++) {
+            CHECK(std::abs(filterbank.result_complex[i] - reference.result_complex[i]) < 1e-9 * max_value);
+        }
+    }
+}
+
+TEST_CASE( "Filterbank: Low-rank kernels", "[Filterbank]" )
+{
+    // Narrow frequency range with many bands per octave: highly correlated kernels
+    float samplerate(1000.);
+    wavelet::Filterbank reference(samplerate, 50., 60., 96);
+    wavelet::Filterbank filterbank(reference);
+    CHECK_THROWS(filterbank.setAttribute<float>("lowrank_accuracy", 10.));
+    filterbank.setAttribute<float>("lowrank_accuracy", -40.);
+    REQUIRE(filterbank.stages_.size() == 1);
+    wavelet::Filterbank::StageDescriptor const& stage = filterbank.stages_[0];
+    REQUIRE(stage.rank > 0);
+    CHECK(stage.rank < 2 * stage.num_bands);
+    CHECK(stage.rank * (stage.length + 2 * stage.num_bands) < filterbank.stage_direct_cost_[0]);
+    
+    // Frobenius norm of the residual below the budget: |error| <= tolerance * ||kernels|| * ||samples||
+    double energy(0.);
+    double max_gain(0.);
+    for (unsigned int i=0; i<filterbank.size(); i++) {
+        for (auto const& v : filterbank.wavelets_[i]->values)
+            energy += std::norm(v);
+        max_gain = std::max(max_gain, filterbank.bands_[i].gain);
+    }
+    double bound = 1e-2 * std::sqrt(energy) * std::sqrt(double(stage.length)) * 1.5 * max_gain;
+    wavelet::Filterbank block_filterbank(filterbank);
+    std::vector<float> values(1000);
+    for (unsigned int t=0; t<values.size(); t++)
+        values[t] = sin(2 * M_PI * 52. * t / samplerate) + 0.5 * sin(2 * M_PI * 57. * t / samplerate);
+    std::vector< std::complex<double> > scalogram;
+    block_filterbank.update(values, scalogram);
+    double max_error(0.);
+    double max_block_error(0.);
+    double max_value(0.);
+    for (unsigned int t=0; t<values.size(); t++) {
+        reference.update(values[t]);
+        filterbank.update(values[t]);
+        for (unsigned int i=0; i<filterbank.size(); i++) {
+            max_error = std::max(max_error, std::abs(filterbank.result_complex[i] - reference.result_complex[i]));
+            max_block_error = std::max(max_block_error, std::abs(filterbank.result_complex[i] - scalogram[t * filterbank.size() + i]));
+            max_value = std::max(max_value, std::abs(reference.result_complex[i]));
+        }
+    }
+    CHECK(max_error > 0.);
+    CHECK(max_error < bound);
+    CHECK(max_error < 1e-2 * max_value);
+    CHECK(max_block_error < 1e-9 * max_value);
+    
+    filterbank.lowrank_accuracy.set(0.);
+    CHECK(filterbank.stages_[0].rank == 0);
+}
+
+TEST_CASE( "Filterbank: Decimated storage", "[Filterbank]" )
+{
+    float samplerate(100.);
+    wavelet::Filterbank reference(samplerate, 1., 30., 4);
+    reference.optimisation.set(wavelet::Filterbank::STANDARD);
+    wavelet::Filterbank filterbank(samplerate, 1., 30., 4);
+    filterbank.optimisation.set(wavelet::Filterbank::AGRESSIVE);
+    REQUIRE(filterbank.data_.size() == reference.data_.size());
+    for (auto const& data : filterbank.data_) {
+        CHECK(data.second.capacity() * data.first == reference.data_[data.first].capacity());
+        CHECK(filterbank.data_latest_.count(data.first) == (data.first > 1 ? 1 : 0));
+    }
+    for (auto const& stage : filterbank.stages_) {
+        CHECK(stage.stride == 1);
+        CHECK((stage.latest != nullptr) == (stage.decimation > 1));
+    }
+    
+    // Agressive mode evaluates each stage once every decimation factor frames, with the same results
+    std::vector<std::size_t> decimations(filterbank.size());
+    for (unsigned int i=0; i<filterbank.size(); i++)
+        decimations[i] = filterbank.bands_[i].decimation;
+    std::vector<char> state;
+    std::vector< std::complex<double> > saved_results;
+    double max_error(0.);
+    double max_value(0.);
+    for (unsigned int t=0; t<1000; t++) {
+        float value = sin(2 * M_PI * 3. * t / samplerate) + 0.5 * sin(2 * M_PI * 11. * t / samplerate);
+        reference.update(value);
+        filterbank.update(value);
+        for (unsigned int i=0; i<filterbank.size(); i++) {
+            if (t % decimations[i] == 0)
+                max_error = std::max(max_error, std::abs(filterbank.result_complex[i] - reference.result_complex[i]));
+            max_value = std::max(max_value, std::abs(reference.result_complex[i]));
+        }
+        if (t == 499)
+            state = filterbank.saveState();
+        if (t == 999)
+            saved_results = filterbank.result_complex;
+    }
+    CHECK(max_error < 1e-9 * max_value);
+    
+    // The latest samples are part of the streaming state
+    filterbank.restoreState(state);
+    for (unsigned int t=500; t<1000; t++)
+        filterbank.update(sin(2 * M_PI * 3. * t / samplerate) + 0.5 * sin(2 * M_PI * 11. * t / samplerate));
+    for (unsigned int i=0; i<filterbank.size(); i++)
+        CHECK(filterbank.result_complex[i] == saved_results[i]);
+}
+
+TEST_CASE( "Filterbank: Decimation policy", "[Filterbank]" )
+{
+    float samplerate(1000.);
+    wavelet::Filterbank reference(samplerate, 2., 200., 12);
+    wavelet::Filterbank exact(reference);
+    exact.optimisation.set(wavelet::Filterbank::STANDARD);
+    wavelet::Filterbank pow2(exact);
+    pow2.setAttribute("decimation", wavelet::Filterbank::POW2);
+    wavelet::Filterbank custom(exact);
+    CHECK_THROWS(custom.setDecimationRates({0, 4}));
+    custom.setDecimationRates({16, 4, 1, 4});
+    CHECK(custom.getDecimationRates() == std::vector<int>({1, 4, 16}));
+    CHECK(custom.downsampling_factors == exact.downsampling_factors);
+    custom.decimation.set(wavelet::Filterbank::CUSTOM);
+    
+    // Quantized factors never exceed the exact factors, and collapse the bands onto fewer stages
+    REQUIRE(pow2.size() == exact.size());
+    REQUIRE(custom.size() == exact.size());
+    std::vector<double> exact_margins = exact.aliasingMargins();
+    std::vector<double> pow2_margins = pow2.aliasingMargins();
+    for (unsigned int i=0; i<exact.size(); i++) {
+        int factor = pow2.downsampling_factors[i];
+        CHECK((factor & (factor - 1)) == 0);
+        CHECK(factor <= exact.downsampling_factors[i]);
+        CHECK(2 * factor > exact.downsampling_factors[i]);
+        CHECK(pow2_margins[i] >= exact_margins[i]);
+        factor = custom.downsampling_factors[i];
+        CHECK((factor == 1 || factor == 4 || factor == 16));
+        CHECK(factor <= exact.downsampling_factors[i]);
+    }
+    CHECK(pow2.stages_.size() < exact.stages_.size());
+    CHECK(custom.stages_.size() <= 3);
+    CHECK(pow2.stageMemory() < exact.stageMemory());
+    CHECK(custom.stageMemory() < exact.stageMemory());
+    CHECK(pow2.multipliesPerSample() > 0.);
+    
+    // Coarser factors do not degrade the estimation of the mean power
+    std::vector<double> reference_power(reference.size(), 0.);
+    std::vector<double> exact_power(exact.size(), 0.);
+    std::vector<double> pow2_power(pow2.size(), 0.);
+    for (unsigned int t=0; t<8000; t++) {
+        float value = sin(2 * M_PI * 7. * t / samplerate) + 0.5 * sin(2 * M_PI * 83. * t / samplerate);
+        reference.update(value);
+        exact.update(value);
+        pow2.update(value);
+        if (t < 4000)
+            continue;
+        for (unsigned int i=0; i<reference.size(); i++) {
+            reference_power[i] += reference.result_power[i];
+            exact_power[i] += exact.result_power[i];
+            pow2_power[i] += pow2.result_power[i];
+        }
+    }
+    double exact_error(0.);
+    double pow2_error(0.);
+    double max_power(0.);
+    for (unsigned int i=0; i<reference.size(); i++) {
+        exact_error = std::max(exact_error, std::abs(exact_power[i] - reference_power[i]));
+        pow2_error = std::max(pow2_error, std::abs(pow2_power[i] - reference_power[i]));
+        max_power = std::max(max_power, reference_power[i]);
+    }
+    CHECK(pow2_error <= exact_error);
+    CHECK(pow2_error < 0.05 * max_power);
+    
+    // The policy and the rates are part of the configuration
+    wavelet::Filterbank copy(custom);
+    CHECK(copy.decimation.get() == wavelet::Filterbank::CUSTOM);
+    CHECK(copy.downsampling_factors == custom.downsampling_factors);
+    CHECK(pow2.configurationFingerprint() != exact.configurationFingerprint());
+}
+
+TEST_CASE( "Filterbank: Shared kernels", "[Filterbank]" )
+{
+    float samplerate(1000.);
+    float bands_per_octave(12);
+    wavelet::Filterbank filterbank(samplerate, 2., 200., bands_per_octave);
+    filterbank.optimisation.set(wavelet::Filterbank::STANDARD);
+    filterbank.decimation.set(wavelet::Filterbank::POW2);
+    
+    // With power-of-two factors, the kernels repeat from one octave to the next
+    std::vector<std::size_t> offsets;
+    for (unsigned int i=0; i<filterbank.size(); i++) {
+        wavelet::Filterbank::BandDescriptor const& band = filterbank.bands_[i];
+        if (std::find(offsets.begin(), offsets.end(), band.offset) == offsets.end())
+            offsets.push_back(band.offset);
+        // Shared kernels match the kernels computed for the band
+        wavelet::MorletWavelet wavelet(*std::static_pointer_cast<wavelet::MorletWavelet>(filterbank.wavelets_[i]));
+        wavelet.init();
+        REQUIRE(wavelet.values.size() == filterbank.wavelets_[i]->values.size());
+        for (unsigned int k=0; k<wavelet.values.size(); k++) {
+            CHECK(std::abs(wavelet.values[k] - filterbank.wavelets_[i]->values[k]) < 1e-9);
+        }
+    }
+    CHECK(offsets.size() < filterbank.size());
+    CHECK(offsets.size() <= 2 * bands_per_octave);
+    
+    // Results are unchanged by the sharing
+    wavelet::Filterbank reference(filterbank);
+    for (unsigned int i=0; i<reference.size(); i++)
+        reference.wavelets_[i]->init();
+    reference.packKernels();
+    double max_error(0.);
+    double max_value(0.);
+    for (unsigned int t=0; t<2000; t++) {
+        float value = sin(2 * M_PI * 7. * t / samplerate) + 0.5 * sin(2 * M_PI * 83. * t / samplerate);
+        filterbank.update(value);
+        reference.update(value);
+        for (unsigned int i=0; i<filterbank.size(); i++) {
+            max_error = std::max(max_error, std::abs(filterbank.result_complex[i] - reference.result_complex[i]));
+            max_value = std::max(max_value, std::abs(reference.result_complex[i]));
+        }
+    }
+    CHECK(max_error < 1e-9 * max_value);
+}
+
+TEST_CASE( "Filterbank: Front-end decimation", "[Filterbank]" )
+{
+    float samplerate(1000.);
+    wavelet::Filterbank reference(samplerate, 2., 20., 12);
+    wavelet::Filterbank filterbank(reference);
+    filterbank.setAttribute("predecimation", true);
+    CHECK(filterbank.frontend_factor_ == 12);
+    REQUIRE(filterbank.size() == reference.size());
+    std::vector<int> reference_delays = reference.delaysInSamples();
+    std::vector<int> delays = filterbank.delaysInSamples();
+    for (unsigned int i=0; i<filterbank.size(); i++) {
+        CHECK(filterbank.scales[i] == reference.scales[i]);
+        CHECK(filterbank.wavelets_[i]->samplerate.get() == Approx(samplerate / 12.));
+        CHECK(delays[i] > reference_delays[i]);
+        CHECK(delays[i] - reference_delays[i] == delays[0] - reference_delays[0]);
+    }
+    CHECK(filterbank.multipliesPerSample() < 0.1 * reference.multipliesPerSample());
+    CHECK(filterbank.stageMemory() < reference.stageMemory());
+    
+    // Same mean power, results held between decimated samples
+    std::vector<float> values(12000);
+    for (unsigned int t=0; t<values.size(); t++)
+        values[t] = sin(2 * M_PI * 3. * t / samplerate) + 0.5 * sin(2 * M_PI * 11. * t / samplerate) + 0.3 * sin(2 * M_PI * 150. * t / samplerate);
+    wavelet::Filterbank block_filterbank(filterbank);
+    std::vector< std::complex<double> > scalogram;
+    block_filterbank.update(values, scalogram);
+    std::vector<double> reference_power(reference.size(), 0.);
+    std::vector<double> power(filterbank.size(), 0.);
+    std::vector<char> state;
+    double max_block_error(0.);
+    std::size_t held_changes(0);
+    for (unsigned int t=0; t<values.size(); t++) {
+        reference.update(values[t]);
+        filterbank.update(values[t]);
+        for (unsigned int i=0; i<filterbank.size(); i++) {
+            max_block_error = std::max(max_block_error, std::abs(filterbank.result_complex[i] - scalogram[t * filterbank.size() + i]));
+            if (t % 12 != 0 && scalogram[t * filterbank.size() + i] != scalogram[(t - 1) * filterbank.size() + i])
+                held_changes++;
+            if (t >= 6000) {
+                reference_power[i] += reference.result_power[i];
+                power[i] += filterbank.result_power[i];
+            }
+        }
+        if (t == 6000 - 1)
+            state = filterbank.saveState();
+    }
+    CHECK(max_block_error < 1e-9);
+    CHECK(held_changes == 0);
+    double max_error(0.);
+    double max_power(0.);
+    for (unsigned int i=0; i<filterbank.size(); i++) {
+        max_error = std::max(max_error, std::abs(power[i] - reference_power[i]));
+        max_power = std::max(max_power, reference_power[i]);
+    }
+    CHECK(max_error < 0.05 * max_power);
+    
+    // The front-end stage is part of the streaming state
+    std::vector< std::complex<double> > results(filterbank.result_complex);
+    filterbank.restoreState(state);
+    for (unsigned int t=6000; t<values.size(); t++)
+        filterbank.update(values[t]);
+    for (unsigned int i=0; i<filterbank.size(); i++)
+        CHECK(filterbank.result_complex[i] == results[i]);
+    
+    // The factor follows frequency_max
+    filterbank.frequency_max.set(40.);
+    CHECK(filterbank.frontend_factor_ == 6);
+    filterbank.predecimation.set(false);
+    CHECK(filterbank.frontend_factor_ == 1);
+}
+
+TEST_CASE( "Filterbank: Front-end decimation in per-sample modes", "[Filterbank]" )
+{
+    float samplerate(1000.);
+    std::vector<std::size_t> block_sizes = {1, 7, 40, 300, 3, 1000, 649};
+    std::vector<float> values;
+    for (auto block_size : block_sizes)
+        for (std::size_t t=0; t<block_size; t++)
+            values.push_back(sin(2 * M_PI * 9. * values.size() / samplerate) + 0.5 * sin(2 * M_PI * 40. * values.size() / samplerate));
+    // Block updates run the front end once, then the same stage updates as update(float)
+    auto check_block_update = [&](wavelet::Filterbank reference, wavelet::Filterbank::Degradation degradation) {
+        REQUIRE(reference.frontend_factor_ == 2);
+        wavelet::Filterbank filterbank(reference);
+        reference.setDegradation(degradation);
+        filterbank.setDegradation(degradation);
+        double max_error(0.);
+        double max_value(0.);
+        std::size_t t(0);
+        for (auto block_size : block_sizes) {
+            std::vector<float> block(values.begin() + t, values.begin() + t + block_size);
+            std::vector< std::complex<double> > scalogram;
+            filterbank.update(block, scalogram);
+            for (std::size_t frame=0; frame<block_size; frame++) {
+                reference.update(values[t++]);
+                for (unsigned int i=0; i<reference.size(); i++) {
+                    max_error = std::max(max_error, std::abs(scalogram[frame * filterbank.size() + i] - reference.result_complex[i]));
+                    max_value = std::max(max_value, std::abs(reference.result_complex[i]));
+                }
+            }
+        }
+        CHECK(max_value > 0.);
+        CHECK(max_error <= 1e-9 * max_value);
+    };
+    wavelet::Filterbank filterbank(samplerate, 5., 120., 6);
+    filterbank.setAttribute("predecimation", true);
+    
+    filterbank.optimisation.set(wavelet::Filterbank::HETERODYNE);
+    REQUIRE_FALSE(filterbank.heterodyne_.empty());
+    check_block_update(filterbank, wavelet::Filterbank::NOMINAL);
+    
+    filterbank.optimisation.set(wavelet::Filterbank::ATROUS);
+    check_block_update(filterbank, wavelet::Filterbank::NOMINAL);
+    
+    // Skipped frames
+    filterbank.optimisation.set(wavelet::Filterbank::STANDARD);
+    check_block_update(filterbank, wavelet::Filterbank::SKIP_FRAMES);
+    filterbank.optimisation.set(wavelet::Filterbank::AGRESSIVE);
+    check_block_update(filterbank, wavelet::Filterbank::SKIP_FRAMES);
+}
+
+TEST_CASE( "Filterbank: Plan", "[Filterbank]" )
+{
+    float samplerate(100.);
+    wavelet::Filterbank filterbank(samplerate, 1., 30., 4);
+    filterbank.optimisation.set(wavelet::Filterbank::STANDARD);
+    double cost(0.);
+    for (auto const& band : filterbank.bands_) {
+        CHECK(band.algorithm == wavelet::Filterbank::BandDescriptor::SYMMETRIC);
+        CHECK(band.cost == 2. * band.half_size);
+        cost += band.cost;
+    }
+    double filters_cost(0.);
+    for (auto const& filter : filterbank.filters_)
+        filters_cost += 2 * filter.second.order.get() + 1;
+    CHECK(filterbank.multipliesPerSample() == Approx(cost + filters_cost));
+    CHECK(filterbank.info().find("symmetric x") != std::string::npos);
+    
+    // Asymmetric kernels are evaluated directly
+    filterbank.setAttribute("mode", wavelet::Wavelet::SPECTRAL);
+    for (auto const& band : filterbank.bands_) {
+        CHECK(band.algorithm == wavelet::Filterbank::BandDescriptor::DIRECT);
+        CHECK(band.cost == 2. * band.window_size);
+    }
+    
+    // Low-rank stages share the cost of their basis among their bands
+    wavelet::Filterbank lowrank(1000., 50., 60., 96);
+    lowrank.lowrank_accuracy.set(-40.);
+    REQUIRE(lowrank.stages_.size() == 1);
+    cost = 0.;
+    for (auto const& band : lowrank.bands_) {
+        CHECK(band.algorithm == wavelet::Filterbank::BandDescriptor::LOWRANK);
+        cost += band.cost;
+    }
+    wavelet::Filterbank::StageDescriptor const& stage = lowrank.stages_[0];
+    CHECK(cost == Approx(stage.rank * (stage.length + 2 * stage.num_bands)));
+    CHECK(cost < lowrank.stage_direct_cost_[0]);
+    CHECK(lowrank.info().find("low-rank x") != std::string::npos);
+}
+
+TEST_CASE( "Filterbank: Plan limits", "[Filterbank]" )
+{
+    // Latency limit: long kernels switch to FFT-partitioned convolution, delayed by the block size - 1
+    float samplerate(1000.);
+    wavelet::Filterbank reference(samplerate, 2., 100., 8);
+    wavelet::Filterbank filterbank(reference);
+    for (auto const& band : filterbank.bands_)
+        CHECK(band.algorithm != wavelet::Filterbank::BandDescriptor::PARTITIONED);
+    CHECK(filterbank.partitioned_.empty());
+    filterbank.setAttribute("max_latency", 64u);
+    REQUIRE(filterbank.stages_.size() == 1);
+    std::size_t block_size = filterbank.stages_[0].block_size;
+    REQUIRE(block_size > 1);
+    CHECK(block_size - 1 <= 64);
+    std::vector<int> delays = filterbank.delaysInSamples();
+    std::vector<int> reference_delays = reference.delaysInSamples();
+    std::size_t num_partitioned(0);
+    double cost(0.);
+    for (unsigned int i=0; i<filterbank.size(); i++) {
+        wavelet::Filterbank::BandDescriptor const& band = filterbank.bands_[i];
+        cost += band.cost;
+        if (band.algorithm == wavelet::Filterbank::BandDescriptor::PARTITIONED) {
+            num_partitioned++;
+            CHECK(band.cost < 2. * band.half_size);
+            CHECK(delays[i] == reference_delays[i] + int(block_size) - 1);
+        } else {
+            CHECK(delays[i] == reference_delays[i]);
+        }
+    }
+    CHECK(num_partitioned > 0);
+    CHECK(filterbank.multipliesPerSample() == Approx(cost));
+    CHECK(filterbank.multipliesPerSample() < reference.multipliesPerSample());
+    CHECK(filterbank.info().find("fft-partitioned x") != std::string::npos);
+    
+    // The delayed outputs match the direct evaluation (sample by sample, by blocks, after a reset and a state restore)
+    std::vector<float> values(3000);
+    for (unsigned int t=0; t<values.size(); t++)
+        values[t] = std::sin(0.02 * t + 1e-5 * t * t) + 0.3 * std::cos(0.37 * t);
+    std::vector< std::vector< std::complex<double> > > reference_results;
+    std::vector< std::vector< std::complex<double> > > results;
+    std::vector< std::complex<double> > scalogram;
+    std::vector<char> state;
+    for (unsigned int pass=0; pass<2; pass++) {
+        reference_results.clear();
+        results.clear();
+        for (unsigned int t=0; t<values.size(); t++) {
+            reference.update(values[t]);
+            reference_results.push_back(reference.result_complex);
+            if (t >= 1000 && t < 1100) {
+                filterbank.update(std::vector<float>(values.begin() + t, values.begin() + t + 1), scalogram);
+            } else {
+                filterbank.update(values[t]);
+            }
+            if (t == 1500)
+                state = filterbank.saveState();
+            results.push_back(filterbank.result_complex);
+        }
+        double max_error(0.);
+        double max_value(0.);
+        for (unsigned int i=0; i<filterbank.size(); i++) {
+            int extra_delay = delays[i] - reference_delays[i];
+            for (unsigned int t=extra_delay; t<values.size(); t++) {
+                max_error = std::max(max_error, std::abs(results[t][i] - reference_results[t - extra_delay][i]));
+                max_value = std::max(max_value, std::abs(reference_results[t][i]));
+            }
+        }
+        CHECK(max_error < 1e-9 * max_value);
+        reference.reset();
+        filterbank.reset();
+    }
+    wavelet::Filterbank restored(filterbank);
+    restored.restoreState(state);
+    for (unsigned int t=1501; t<values.size(); t++)
+        restored.update(values[t]);
+    for (unsigned int i=0; i<filterbank.size(); i++)
+        CHECK(std::abs(restored.result_complex[i] - results.back()[i]) < 1e-12 * std::abs(results.back()[i]) + 1e-12);
+    
+    // A larger latency allows larger blocks
+    double multiplies = filterbank.multipliesPerSample();
+    filterbank.max_latency.set(1024);
+    CHECK(filterbank.stages_[0].block_size > block_size);
+    CHECK(filterbank.multipliesPerSample() < multiplies);
+    filterbank.max_latency.set(0);
+    CHECK(filterbank.partitioned_.empty());
+    CHECK(filterbank.multipliesPerSample() == Approx(reference.multipliesPerSample()));
+    
+    // Block updates with predecimation run the front end once before the partitioned stages
+    wavelet::Filterbank decimated(samplerate, 5., 120., 6);
+    decimated.setAttribute("predecimation", true);
+    decimated.setAttribute("max_latency", 32u);
+    REQUIRE(decimated.frontend_factor_ == 2);
+    REQUIRE_FALSE(decimated.partitioned_.empty());
+    wavelet::Filterbank block_decimated(decimated);
+    block_decimated.update(values, scalogram);
+    double max_block_error(0.);
+    double max_block_value(0.);
+    for (unsigned int t=0; t<values.size(); t++) {
+        decimated.update(values[t]);
+        for (unsigned int i=0; i<decimated.size(); i++) {
+            max_block_error = std::max(max_block_error, std::abs(scalogram[t * decimated.size() + i] - decimated.result_complex[i]));
+            max_block_value = std::max(max_block_value, std::abs(decimated.result_complex[i]));
+        }
+    }
+    CHECK(max_block_value > 0.);
+    CHECK(max_block_error <= 1e-9 * max_block_value);
+    
+    // Accuracy limit: the low-rank basis is only used if its rank fits in the budget
+    wavelet::Filterbank lowrank(1000., 50., 60., 96);
+    lowrank.lowrank_accuracy.set(-40.);
+    REQUIRE(lowrank.stages_.size() == 1);
+    CHECK(lowrank.stages_[0].rank > 0);
+    for (auto const& band : lowrank.bands_)
+        CHECK(band.algorithm == wavelet::Filterbank::BandDescriptor::LOWRANK);
+    lowrank.lowrank_accuracy.set(-300.);
+    CHECK(lowrank.stages_[0].rank == 0);
+    for (auto const& band : lowrank.bands_)
+        CHECK(band.algorithm == wavelet::Filterbank::BandDescriptor::SYMMETRIC);
+}
+
+TEST_CASE( "Filterbank: Constant-Q engine", "[Filterbank]" )
+{
+    float samplerate(100.);
+    std::size_t hop_size(8);
+    wavelet::Filterbank reference(samplerate, 1., 30., 4);
+    wavelet::Filterbank filterbank(samplerate, 1., 30., 4);
+    filterbank.optimisation.set(wavelet::Filterbank::STANDARD);
+    std::vector< std::complex<double> > frames;
+    CHECK_THROWS(filterbank.updateSpectral(std::vector<float>(10, 0.), frames));
+    CHECK_THROWS(filterbank.initSpectral(0, 0.));
+    CHECK_THROWS(filterbank.initSpectral(hop_size, 10.));
+    filterbank.initSpectral(hop_size, 0.);
+    CHECK(filterbank.info().find("Constant-Q engine") != std::string::npos);
+    
+    // Without sparsity, the frames are the results of the online filterbank (NONE mode) every hop_size samples
+    std::vector<float> values(800);
+    for (std::size_t t=0; t<values.size(); t++) {
+        values[t] = 0.5 + sin(2 * M_PI * 7. * t / samplerate) + 0.3 * float(t % 13) / 13.;
+    }
+    std::vector< std::complex<double> > scalogram;
+    // After reset(), the history of update() is warm-filled with the first sample, as in the engine
+    reference.reset();
+    reference.update(values, scalogram);
+    filterbank.updateSpectral(values, frames);
+    std::size_t num_bands = reference.size();
+    REQUIRE(frames.size() == (values.size() / hop_size) * num_bands);
+    // First hop: no transient from a zero history
+    for (std::size_t i=0; i<num_bands; i++)
+        CHECK(std::abs(frames[i] - scalogram[(hop_size - 1) * num_bands + i]) < 1e-9 * std::abs(scalogram[(hop_size - 1) * num_bands + i]));
+    double max_error(0.);
+    double max_value(0.);
+    for (std::size_t frame=0; frame<values.size()/hop_size; frame++) {
+        std::size_t t = (frame + 1) * hop_size - 1;
+        for (std::size_t i=0; i<num_bands; i++) {
+            max_error = std::max(max_error, std::abs(frames[frame * num_bands + i] - scalogram[t * num_bands + i]));
+            max_value = std::max(max_value, std::abs(scalogram[t * num_bands + i]));
+        }
+    }
+    CHECK(max_error < 1e-9 * max_value);
+    std::size_t exact_cost = filterbank.spectralMultiplies();
+    
+    // Sparse kernels: fewer multiplies than the dot products of the windows, within the accuracy budget
+    filterbank.initSpectral(hop_size, -40.);
+    filterbank.updateSpectral(values, frames);
+    std::size_t window_taps(0);
+    for (auto const& wavelet : reference.wavelets_)
+        window_taps += wavelet->window_size.get();
+    CHECK(filterbank.spectralMultiplies() < exact_cost);
+    CHECK(filterbank.spectralMultiplies() < hop_size * window_taps);
+    double error(0.);
+    double power(0.);
+    for (std::size_t frame=0; frame<values.size()/hop_size; frame++) {
+        std::size_t t = (frame + 1) * hop_size - 1;
+        for (std::size_t i=0; i<num_bands; i++) {
+            error += std::norm(frames[frame * num_bands + i] - scalogram[t * num_bands + i]);
+            power += std::norm(scalogram[t * num_bands + i]);
+        }
+    }
+    CHECK(std::sqrt(error / power) < 0.05);
+    
+    // The kernels follow the configuration of the filterbank
+    filterbank.frequency_max.set(20.);
+    filterbank.updateSpectral(std::vector<float>(hop_size, 0.), frames);
+    CHECK(frames.size() == filterbank.size());
+}
+
+TEST_CASE( "Filterbank: Heterodyne", "[Filterbank]" )
+{
+    // High-Q bands: large carrier frequency and many bands per octave
+    float samplerate(1000.);
+    wavelet::Filterbank reference(samplerate, 50., 200., 24);
+    reference.setAttribute<float>("omega0", 20.);
+    wavelet::Filterbank filterbank(reference);
+    filterbank.optimisation.set(wavelet::Filterbank::HETERODYNE);
+    REQUIRE(filterbank.heterodyne_.size() == filterbank.size());
+    std::vector<int> delays = filterbank.delaysInSamples();
+    std::vector<int> reference_delays = reference.delaysInSamples();
+    std::size_t num_channels(0);
+    for (unsigned int i=0; i<filterbank.size(); i++) {
+        if (filterbank.bands_[i].algorithm == wavelet::Filterbank::BandDescriptor::HETERODYNE) {
+            num_channels++;
+            CHECK(filterbank.heterodyne_[i].decimation > 1);
+            CHECK(filterbank.heterodyne_[i].envelope.size() < filterbank.wavelets_[i]->window_size.get());
+            CHECK(delays[i] > reference_delays[i]);
+        }
+    }
+    CHECK(num_channels == filterbank.size());
+    CHECK(filterbank.multipliesPerSample() < 0.25 * reference.multipliesPerSample());
+    // No wideband gather nor convolution: the cost per sample is the cost of the channels only
+    double channel_multiplies(0.);
+    for (auto const& channel : filterbank.heterodyne_) {
+        double filter_order = 2. * double(channel.filter_real.order.get()) + 1.;
+        channel_multiplies += 2. + 2. * filter_order + 8. + 4. * double(channel.envelope.size()) / double(channel.decimation);
+    }
+    CHECK(filterbank.multipliesPerSample() == Approx(channel_multiplies));
+    for (auto const& stage : filterbank.stages_)
+        CHECK(stage.gathered_bands == 0);
+    CHECK(filterbank.info().find("heterodyne x") != std::string::npos);
+    
+    // Error check against the reference (mean power, the baseband filters add latency)
+    std::vector<float> values(8000);
+    for (std::size_t t=0; t<values.size(); t++) {
+        values[t] = sin(2 * M_PI * 73. * t / samplerate) + 0.5 * sin(2 * M_PI * 151.3 * t / samplerate);
+    }
+    std::vector< std::complex<double> > reference_scalogram;
+    std::vector< std::complex<double> > scalogram;
+    reference.update(values, reference_scalogram);
+    filterbank.update(values, scalogram);
+    double power_error(0.);
+    double power(0.);
+    for (std::size_t i=0; i<filterbank.size(); i++) {
+        double band_power(0.);
+        double reference_band_power(0.);
+        for (std::size_t t=values.size()/2; t<values.size(); t++) {
+            band_power += std::norm(scalogram[t * filterbank.size() + i]);
+            reference_band_power += std::norm(reference_scalogram[t * filterbank.size() + i]);
+        }
+        power_error += std::abs(band_power - reference_band_power);
+        power += reference_band_power;
+    }
+    CHECK(power_error < 0.05 * power);
+    
+    // The channels are part of the streaming state
+    std::vector<char> state = filterbank.saveState();
+    wavelet::Filterbank restored(filterbank);
+    restored.restoreState(state);
+    for (unsigned int t=0; t<100; t++) {
+        float value = sin(2 * M_PI * 97. * t / samplerate);
+        filterbank.update(value);
+        restored.update(value);
+    }
+    for (unsigned int i=0; i<filterbank.size(); i++) {
+        CHECK(restored.result_complex[i] == filterbank.result_complex[i]);
+    }
+}
+
+TEST_CASE( "Filterbank: A trous", "[Filterbank]" )
+{
+    float samplerate(1000.);
+    wavelet::Filterbank reference(samplerate, 2., 400., 4);
+    wavelet::Filterbank filterbank(reference);
+    filterbank.optimisation.set(wavelet::Filterbank::ATROUS);
+    // Dyadic levels computed recursively, without low-pass filters
+    CHECK(filterbank.filters_.empty());
+    int level(1);
+    for (auto const& data : filterbank.data_) {
+        CHECK(data.first == level);
+        level *= 2;
+    }
+    for (unsigned int i=0; i<filterbank.size(); i++) {
+        int factor = filterbank.downsampling_factors[i];
+        CHECK((factor & (factor - 1)) == 0);
+    }
+    CHECK(filterbank.downsampling_factors.back() > 8);
+    CHECK(filterbank.multipliesPerSample() < 0.25 * reference.multipliesPerSample());
+    CHECK(filterbank.info().find("A trous cascade") != std::string::npos);
+    std::vector<int> delays = filterbank.delaysInSamples();
+    std::vector<int> reference_delays = reference.delaysInSamples();
+    for (unsigned int i=0; i<filterbank.size(); i++) {
+        if (filterbank.downsampling_factors[i] > 1)
+            CHECK(delays[i] > reference_delays[i]);
+    }
+    
+    // Error check against the reference (mean power, the cascade adds latency)
+    std::vector<float> values(20000);
+    for (std::size_t t=0; t<values.size(); t++) {
+        values[t] = sin(2 * M_PI * 5.3 * t / samplerate) + 0.5 * sin(2 * M_PI * 37. * t / samplerate) + 0.3 * sin(2 * M_PI * 211. * t / samplerate);
+    }
+    std::vector< std::complex<double> > reference_scalogram;
+    std::vector< std::complex<double> > scalogram;
+    reference.update(values, reference_scalogram);
+    filterbank.update(values, scalogram);
+    double power_error(0.);
+    double power(0.);
+    for (std::size_t i=0; i<filterbank.size(); i++) {
+        double band_power(0.);
+        double reference_band_power(0.);
+        for (std::size_t t=values.size()/2; t<values.size(); t++) {
+            band_power += std::norm(scalogram[t * filterbank.size() + i]);
+            reference_band_power += std::norm(reference_scalogram[t * filterbank.size() + i]);
+        }
+        power_error += std::abs(band_power - reference_band_power);
+        power += reference_band_power;
+    }
+    CHECK(power_error < 0.05 * power);
+}
+
+TEST_CASE( "Filterbank: CPU budget", "[Filterbank]" )
+{
+    float samplerate(1000.);
+    wavelet::Filterbank filterbank(samplerate, 2., 400., 8);
+    wavelet::Filterbank reference(filterbank);
+    double nominal_multiplies = filterbank.multipliesPerSample();
+    CHECK(filterbank.degradation() == wavelet::Filterbank::NOMINAL);
+    
+    // An unreachable budget degrades the quality step by step, with the prebuilt plans
+    CHECK(filterbank.plans_[wavelet::Filterbank::SHORTER_KERNELS].bands.empty());
+    filterbank.cpu_budget.set(1e-6);
+    REQUIRE(!filterbank.plans_[wavelet::Filterbank::SHORTER_KERNELS].bands.empty());
+    const double* shorter_arena = filterbank.plans_[wavelet::Filterbank::SHORTER_KERNELS].kernel_arena.data();
+    for (unsigned int t=0; t<8000; t++)
+        filterbank.update(float(sin(2 * M_PI * 37. * t / samplerate)));
+    CHECK(filterbank.degradation() == wavelet::Filterbank::SHORTER_KERNELS);
+    CHECK(filterbank.kernel_arena_.data() == shorter_arena);
+    CHECK(filterbank.cpuLoad() > 0.);
+    CHECK(filterbank.multipliesPerSample() < 0.2 * nominal_multiplies);
+    CHECK(filterbank.info().find("shorter kernels") != std::string::npos);
+    for (unsigned int i=0; i<filterbank.size(); i++)
+        CHECK(filterbank.bands_[i].window_size < reference.bands_[i].window_size);
+    
+    // A new budget restores the nominal quality
+    filterbank.cpu_budget.set(10.);
+    CHECK(filterbank.degradation() == wavelet::Filterbank::NOMINAL);
+    CHECK(filterbank.multipliesPerSample() == Approx(nominal_multiplies));
+    
+    // Hysteresis: each level is held while settling, and is lowered once the load drops
+    for (unsigned int t=0; t<1023; t++)
+        filterbank.governCpuLoad(20., 1);
+    CHECK(filterbank.degradation() == wavelet::Filterbank::NOMINAL);
+    filterbank.governCpuLoad(20., 1);
+    CHECK(filterbank.degradation() == wavelet::Filterbank::SKIP_FRAMES);
+    filterbank.governCpuLoad(20. * 1024., 1024);
+    CHECK(filterbank.degradation() == wavelet::Filterbank::SHORT_KERNELS);
+    filterbank.governCpuLoad(4. * 1024., 1024);
+    CHECK(filterbank.degradation() == wavelet::Filterbank::SHORT_KERNELS);
+    filterbank.governCpuLoad(1. * 1024., 1024);
+    CHECK(filterbank.degradation() == wavelet::Filterbank::SKIP_FRAMES);
+    filterbank.governCpuLoad(1. * 1024., 1024);
+    CHECK(filterbank.degradation() == wavelet::Filterbank::NOMINAL);
+    
+    // The levels keep the heterodyne channels and the partitioned bands (hence the delays)
+    wavelet::Filterbank heterodyne(samplerate, 2., 400., 8);
+    heterodyne.optimisation.set(wavelet::Filterbank::HETERODYNE);
+    heterodyne.max_latency.set(64);
+    heterodyne.cpu_budget.set(10.);
+    std::vector<int> delays = heterodyne.delaysInSamples();
+    nominal_multiplies = heterodyne.multipliesPerSample();
+    for (unsigned int t=0; t<1000; t++)
+        heterodyne.update(float(sin(2 * M_PI * 37. * t / samplerate)));
+    std::vector<wavelet::Filterbank::HeterodyneChannel> channels(heterodyne.heterodyne_);
+    REQUIRE(heterodyne.partitioned_.size() == 1);
+    std::size_t count = heterodyne.partitioned_[0].count;
+    std::vector<wavelet::Filterbank::BandDescriptor> nominal_bands(heterodyne.bands_);
+    const double* short_arena = heterodyne.plans_[wavelet::Filterbank::SHORT_KERNELS].kernel_arena.data();
+    heterodyne.setDegradation(wavelet::Filterbank::SHORT_KERNELS);
+    CHECK(heterodyne.kernel_arena_.data() == short_arena);
+    CHECK(heterodyne.delaysInSamples() == delays);
+    CHECK(heterodyne.multipliesPerSample() < nominal_multiplies);
+    CHECK(heterodyne.partitioned_[0].count == count);
+    std::size_t num_heterodyne(0);
+    std::size_t num_partitioned(0);
+    for (unsigned int i=0; i<heterodyne.size(); i++) {
+        CHECK(heterodyne.bands_[i].window_size <= nominal_bands[i].window_size);
+        if (nominal_bands[i].algorithm == wavelet::Filterbank::BandDescriptor::HETERODYNE) {
+            num_heterodyne++;
+            CHECK(heterodyne.bands_[i].algorithm == wavelet::Filterbank::BandDescriptor::HETERODYNE);
+            CHECK(heterodyne.heterodyne_[i].index == channels[i].index);
+            CHECK(heterodyne.heterodyne_[i].phasor == channels[i].phasor);
+        } else if (nominal_bands[i].algorithm == wavelet::Filterbank::BandDescriptor::PARTITIONED) {
+            num_partitioned++;
+            CHECK(heterodyne.bands_[i].algorithm == wavelet::Filterbank::BandDescriptor::PARTITIONED);
+            CHECK(heterodyne.bands_[i].partitions <= nominal_bands[i].partitions);
+        } else {
+            CHECK(heterodyne.bands_[i].algorithm != wavelet::Filterbank::BandDescriptor::HETERODYNE);
+            CHECK(heterodyne.bands_[i].algorithm != wavelet::Filterbank::BandDescriptor::PARTITIONED);
+        }
+    }
+    CHECK(num_heterodyne > 0);
+    CHECK(num_partitioned > 0);
+    heterodyne.setDegradation(wavelet::Filterbank::NOMINAL);
+    CHECK(heterodyne.multipliesPerSample() == Approx(nominal_multiplies));
+    
+    // Skipped frames hold the results in block updates too
+    wavelet::Filterbank skipping(reference);
+    skipping.setDegradation(wavelet::Filterbank::SKIP_FRAMES);
+    wavelet::Filterbank block_skipping(skipping);
+    block_skipping.setDegradation(wavelet::Filterbank::SKIP_FRAMES);
+    std::vector<float> values(500);
+    for (std::size_t t=0; t<values.size(); t++)
+        values[t] = sin(2 * M_PI * 37. * t / samplerate);
+    std::vector< std::complex<double> > scalogram;
+    block_skipping.update(values, scalogram);
+    for (std::size_t t=0; t<values.size(); t++) {
+        skipping.update(values[t]);
+        for (unsigned int i=0; i<skipping.size(); i++) {
+            REQUIRE(scalogram[t * skipping.size() + i] == skipping.result_complex[i]);
+            if (t > 0 && (t % skipping.bands_[i].hold) != 0)
+                REQUIRE(scalogram[t * skipping.size() + i] == scalogram[(t - 1) * skipping.size() + i]);
+        }
+    }
+}
+
+TEST_CASE( "Filterbank: Tuner", "[Filterbank]" )
+{
+    wavelet::Tuner tuner(1000., 10., 200., 4);
+    tuner.optimisations = {wavelet::Filterbank::NONE, wavelet::Filterbank::STANDARD, wavelet::Filterbank::AGRESSIVE};
+    tuner.delays = {1.5, 2.};
+    tuner.paddings = {1.};
+    tuner.tolerance = -15.;
+    wavelet::Tuner::Candidate best = tuner.tune();
+    REQUIRE(tuner.candidates().size() == 6);
+    CHECK(best.feasible);
+    CHECK(best.error <= tuner.tolerance);
+    for (auto const& candidate : tuner.candidates()) {
+        CHECK(candidate.time > 0.);
+        CHECK(candidate.latency > 0);
+        if (candidate.feasible)
+            CHECK(best.time <= candidate.time);
+    }
+    CHECK(tuner.info().find("STANDARD") != std::string::npos);
+    
+    // The reference configuration (largest delay and padding, no optimisation) always meets the tolerance
+#ifndef USE_ARMA
+    tuner.tolerance = -100.;
+    best = tuner.tune();
+    CHECK(best.optimisation == wavelet::Filterbank::NONE);
+    CHECK(best.delay == 2.);
+#endif
+    
+    // The chosen configuration can be applied to a filterbank
+    wavelet::Filterbank filterbank(1000., 10., 200., 8);
+    wavelet::Tuner::configure(filterbank, best);
+    CHECK(filterbank.optimisation.get() == best.optimisation);
+    CHECK(filterbank.bands_per_octave.get() == Approx(4.));
+    CHECK(filterbank.getAttribute<float>("delay") == Approx(best.delay));
+    
+    // Unreachable targets
+    tuner.cpu_budget = 1e-9;
+    CHECK_THROWS_AS(tuner.tune(), std::runtime_error);
+    tuner.tolerance = 1.;
+    CHECK_THROWS_AS(tuner.tune(), std::domain_error);
+    CHECK_THROWS_AS(wavelet::Tuner(1000., 10., 600., 4), std::domain_error);
+}
+
+TEST_CASE( "Filterbank: Symmetric kernels", "[Filterbank]" )
+{
+    float samplerate(100.);
+    wavelet::Filterbank filterbank(samplerate, 1., 30., 4);
+    filterbank.optimisation.set(wavelet::Filterbank::STANDARD);
+    for (unsigned int order=0; order<3; order++) {
+        if (order > 0) {
+            filterbank.family.set(wavelet::PAUL);
+            filterbank.setAttribute<unsigned int>("order", order + 2);
+        }
+        filterbank.reset();
+        wavelet::Wavelet::KernelSymmetry expected_symmetry = (order == 1) ? wavelet::Wavelet::ANTIHERMITIAN : wavelet::Wavelet::HERMITIAN;
+        for (unsigned int i=0; i<filterbank.size(); i++) {
+            CHECK(filterbank.bands_[i].symmetry == expected_symmetry);
+        }
+        // Compare with a direct convolution by the full conjugate kernel
+        double max_error(0.);
+        double max_value(0.);
+        for (unsigned int t=0; t<500; t++) {
+            filterbank.update(sin(2 * M_PI * 7. * t / samplerate) + 0.3 * float(t % 13) / 13.);
+            for (unsigned int i=0; i<filterbank.size(); i++) {
+                wavelet::Filterbank::BandDescriptor const& band = filterbank.bands_[i];
+                boost::circular_buffer<float> const& buffer = *band.buffer;
+                std::vector< std::complex<double> > const& values = filterbank.wavelets_[i]->values;
+                std::complex<double> expected = double(buffer.front()) * band.prepad_value + double(buffer.back()) * band.postpad_value;
+                for (std::size_t k=0; k<values.size(); k++) {
+                    expected += double(buffer[buffer.size() - band.lag + k * band.decimation]) * std::conj(values[k]);
+                }
+                expected *= band.gain;
+                max_error = std::max(max_error, std::abs(filterbank.result_complex[i] - expected));
+                max_value = std::max(max_value, std::abs(expected));
+            }
+        }
+        CHECK(max_error < 1e-9 * max_value);
+    }
+}
+
+TEST_CASE( "Filterbank: Kernel truncation", "[Filterbank]" )
+{
+    float samplerate(100.);
+    wavelet::Filterbank reference(samplerate, 1., 30., 4);
+    reference.setAttribute<float>("delay", 3.);
+    wavelet::Filterbank filterbank(samplerate, 1., 30., 4);
+    filterbank.setAttribute<float>("delay", 3.);
+    CHECK_THROWS(filterbank.setAttribute<float>("accuracy", 10.));
+    filterbank.setAttribute<float>("accuracy", -60.);
+    std::vector<std::size_t> savings = filterbank.macSavings();
+    REQUIRE(savings.size() == filterbank.size());
+    CHECK(savings.back() > 0);
+    for (unsigned int i=0; i<filterbank.size(); i++) {
+        CHECK(filterbank.bands_[i].window_size + savings[i] == filterbank.wavelets_[i]->window_size.get());
+    }
+    // Dropped taps of weight at most tolerance * L1 are replaced by a padding
+    // value, hence an error bounded by twice that weight times the peak input
+    // (with some headroom for the anti-aliasing filters' overshoot)
+    std::vector<double> bound(filterbank.size(), 0.);
+    for (unsigned int i=0; i<filterbank.size(); i++) {
+        for (auto const& v : filterbank.wavelets_[i]->values) {
+            bound[i] += std::abs(v);
+        }
+        bound[i] *= 2. * 1e-3 * 2. * filterbank.bands_[i].gain;
+    }
+    bool within_bound(true);
+    for (unsigned int t=0; t<1000; t++) {
+        float value = sin(2 * M_PI * 3. * t / samplerate) + 0.5 * sin(2 * M_PI * 11. * t / samplerate);
+        reference.update(value);
+        filterbank.update(value);
+        for (unsigned int i=0; i<filterbank.size(); i++) {
+            within_bound &= std::abs(filterbank.result_complex[i] - reference.result_complex[i]) <= bound[i];
+        }
+    }
+    CHECK(within_bound);
+    filterbank.accuracy.set(0.);
+    savings = filterbank.macSavings();
+    for (unsigned int i=0; i<filterbank.size(); i++) {
+        CHECK(savings[i] == 0);
+    }
+}
+
 TEST_CASE( "Filterbank: Scales", "[Filterbank]" )
 {
     float samplerate(100.);
@@ -175,3 +175,65 @@ TEST_CASE( "MorletWavelet: Values (Recursive)", "[MorletWavelet]" )
         CHECK(morlet.values[i].imag() == Approx(morlet_ref2[i].imag()));
     }
 }
+
+TEST_CASE( "MorletWavelet: Kernel recurrences", "[MorletWavelet]" )
+{
+    float samplerate = 100.;
+    wavelet::MorletWavelet morlet(samplerate);
+    morlet.scale.set(1.3);
+    morlet.omega0.set(6.);
+    std::size_t length(4001);
+    double center(2000.);
+    double width = morlet.scale.get() * morlet.samplerate.get();
+    std::vector< std::complex<double> > values(length);
+    morlet.phi_sequence(-517, length, center, width, values.data());
+    double max_error(0.);
+    for (std::size_t k=0; k<length; k++) {
+        std::complex<double> reference = morlet.phi((double(-517 + int(k)) - center) / width);
+        max_error = std::max(max_error, std::abs(values[k] - reference));
+    }
+    CHECK(max_error < 1e-12);
+}
+
+TEST_CASE( "MorletWavelet: Padding", "[MorletWavelet]" )
+{
+    float samplerate = 100.;
+    wavelet::MorletWavelet morlet(samplerate);
+    for (double scale : {0.5, 2., 10.}) {
+        morlet.scale.set(scale);
+        morlet.setDefaultWindowsize();
+        int pad_length = static_cast<int>(morlet.padding.get() * morlet.eFoldingTime() * samplerate);
+        double center = double(morlet.window_size.get() / 2);
+        double width = scale * samplerate;
+        std::vector< std::complex<double> > values(pad_length);
+        morlet.phi_sequence(-pad_length, pad_length, center, width, values.data());
+        std::complex<double> prepad(0., 0.);
+        for (int t=0; t<pad_length; t++) {
+            prepad += std::conj(values[t]);
+        }
+        CHECK(std::abs(morlet.prepad_value_ - prepad) < 1e-8 * std::abs(prepad));
+    }
+}
+
+TEST_CASE( "MorletWavelet: Padding at high omega0", "[MorletWavelet]" )
+{
+    float samplerate = 1000.;
+    wavelet::MorletWavelet morlet(samplerate);
+    for (float omega0 : {20.f, 40.f, 80.f}) {
+        morlet.omega0.set(omega0);
+        for (double scale : {0.1, 0.5}) {
+            morlet.scale.set(scale);
+            double width = scale * samplerate;
+            // sums across the oscillating center of the wavelet, and over its tail
+            for (int first : {-static_cast<int>(width), static_cast<int>(width)}) {
+                std::size_t length = static_cast<std::size_t>(2. * width);
+                std::vector< std::complex<double> > values(length);
+                morlet.phi_sequence(first, length, 0., width, values.data());
+                std::complex<double> direct(0., 0.);
+                for (auto value : values)
+                    direct += value;
+                CHECK(std::abs(morlet.phi_sum(first, length, 0., width) - direct) < 1e-9 * std::abs(direct));
+            }
+        }
+    }
+}
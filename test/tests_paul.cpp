@@ -48,3 +48,85 @@ TEST_CASE( "PaulWavelet: Filterbank", "[PaulWavelet]" )
                                    bands_per_octave);
     filterbank.family.set(wavelet::PAUL);
 }
+
+TEST_CASE( "PaulWavelet: Kernel generation", "[PaulWavelet]" )
+{
+    float samplerate = 100.;
+    wavelet::PaulWavelet paul(samplerate);
+    paul.scale.set(0.2);
+    double width = paul.scale.get() * paul.samplerate.get();
+    std::size_t length(40001);
+    double center(20000.);
+    std::vector< std::complex<double> > values(length);
+    for (unsigned int order=1; order<=16; order++) {
+        paul.order.set(order);
+        paul.phi_sequence(0, length, center, width, values.data());
+        double energy(0.);
+        double max_error(0.);
+        for (std::size_t k=0; k<length; k++) {
+            energy += std::norm(values[k]);
+            max_error = std::max(max_error, std::abs(values[k] - paul.phi((double(k) - center) / width)));
+        }
+        CHECK(max_error < 1e-12);
+        // unit energy (checks the normalization for large orders)
+        CHECK(energy == Approx(1.).epsilon(1e-3));
+        // partial grids: half-integer center (mirrored), and grid after the center (not mirrored)
+        std::vector< std::complex<double> > partial(501);
+        for (double grid_center : {12.5, -300.}) {
+            paul.phi_sequence(-7, partial.size(), grid_center, width, partial.data());
+            max_error = 0.;
+            for (std::size_t k=0; k<partial.size(); k++)
+                max_error = std::max(max_error, std::abs(partial[k] - paul.phi((double(k) - 7. - grid_center) / width)));
+            CHECK(max_error < 1e-12);
+        }
+    }
+    paul.order.set(4);
+    CHECK(paul.phi(0.5).real() == Approx(-0.0938781628));
+    CHECK(paul.phi(0.5).imag() == Approx(0.1012895967));
+}
+
+TEST_CASE( "PaulWavelet: Padding", "[PaulWavelet]" )
+{
+    float samplerate = 100.;
+    wavelet::PaulWavelet paul(samplerate);
+    for (unsigned int order : {2, 4, 10, 40}) {
+        paul.order.set(order);
+        CHECK(std::abs(paul.phi_integral(-3., 1.5) - paul.Wavelet::phi_integral(-3., 1.5)) < 1e-12);
+        for (double scale : {0.5, 2., 10.}) {
+            paul.scale.set(scale);
+            paul.setDefaultWindowsize();
+            int pad_length = static_cast<int>(paul.padding.get() * paul.eFoldingTime() * samplerate);
+            double center = double(paul.window_size.get() / 2);
+            double width = scale * samplerate;
+            std::vector< std::complex<double> > values(pad_length);
+            paul.phi_sequence(static_cast<int>(paul.window_size.get()), pad_length, center, width, values.data());
+            std::complex<double> postpad(0., 0.);
+            for (int t=0; t<pad_length; t++) {
+                postpad += std::conj(values[t]);
+            }
+            CHECK(std::abs(paul.postpad_value_ - postpad) < 1e-8 * std::abs(postpad));
+        }
+    }
+}
+
+TEST_CASE( "PaulWavelet: Padding at high order", "[PaulWavelet]" )
+{
+    float samplerate = 1000.;
+    wavelet::PaulWavelet paul(samplerate);
+    for (unsigned int order : {16, 40, 60}) {
+        paul.order.set(order);
+        for (double scale : {0.1, 0.5}) {
+            paul.scale.set(scale);
+            double width = scale * samplerate;
+            for (int first : {-static_cast<int>(width), static_cast<int>(width)}) {
+                std::size_t length = static_cast<std::size_t>(2. * width);
+                std::vector< std::complex<double> > values(length);
+                paul.phi_sequence(first, length, 0., width, values.data());
+                std::complex<double> direct(0., 0.);
+                for (auto value : values)
+                    direct += value;
+                CHECK(std::abs(paul.phi_sum(first, length, 0., width) - direct) < 1e-9 * std::abs(direct));
+            }
+        }
+    }
+}